@@ -5,7 +5,7 @@
 #ifndef BASETYPES_H
 #define BASETYPES_H
 
-#include "GL\glm\gtc\quaternion.hpp" // fquat
+#include "GL/glm/gtc/quaternion.hpp" // fquat
 typedef glm::fquat Quaternion;
 typedef glm::mat4 Matrix4;
 
@@ -18,4 +18,4 @@ typedef unsigned short ushort;
 typedef unsigned char uchar;
 typedef unsigned char byte;
 
-#endif BASETYPES_H
\ No newline at end of file
+#endif // BASETYPES_H
\ No newline at end of file
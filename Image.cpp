@@ -4,7 +4,6 @@
 #include "Image.h"
 #include <stdio.h>
 #include <string.h>
-#include "GL\glew.h"
 
 
 	/**
@@ -108,7 +107,7 @@
 	//// ---- BMP format structures ---- ////
 #pragma pack(push)
 #pragma pack(1) // make sure no struct alignment packing is made
-	struct CIEXYZTRIPLE { struct CIEXYZ { long x, y, z; } r, g, b; };
+	struct CIEXYZTRIPLE { struct CIEXYZ { int x, y, z; } r, g, b; }; // LONG is 32-bit, unlike long on 64-bit Linux
 	struct RGBQUAD { unsigned char b, g, r, x; };
 	struct BitmapFileHeader { ushort Type; unsigned Size, Reserved, OffBits; };
 	struct BitmapInfoHeader { unsigned Size; int Width, Height; ushort Planes, BitCount; unsigned Compression, SizeImage; unsigned XPelsPerMeter, YPelsPerMeter; unsigned ClrUsed, ClrImportant; };
@@ -213,6 +212,8 @@
 			case 3: *pf = FMT_BGR; break;
 			case 4: *pf = FMT_BGRA; break;
 		}
+		if (!bmi.SizeImage) // allowed for uncompressed images, the rows are padded to 4 bytes
+			bmi.SizeImage = ((bmi.Width * bmi.BitCount / 8 + 3) & ~3) * (bmi.Height < 0 ? -bmi.Height : bmi.Height);
 		*data = (byte*)malloc(bmi.SizeImage); // allocate enough for the entire image
 		fseek(file, bmh.OffBits, SEEK_SET); // seek to start of image data
 		fread(*data, bmi.SizeImage, 1, file); // read the image data
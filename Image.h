@@ -6,6 +6,7 @@
 #define IMAGE_H
 
 #include "Basetypes.h"
+#include <string.h>
 
 enum ImageFileFormat 
 {
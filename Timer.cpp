@@ -1,12 +1,29 @@
 #include "Timer.h"
+#ifdef _WIN32
 #include <Windows.h>
 
-
+static inline long long TimerTicks()
+{
+	long long ticks;
+	QueryPerformanceCounter((LARGE_INTEGER*)&ticks);
+	return ticks;
+}
 static double mDFrequency = [](){
 	long long freq;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
 	return (double)freq;
 }();
+#else // POSIX, for the headless tools
+#include <time.h>
+
+static inline long long TimerTicks()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+static double mDFrequency = 1000000000.0; // nanoseconds
+#endif
 static float mFFrequency = (float)mDFrequency;
 
 // initializes a stopped timer
@@ -16,17 +33,17 @@ Timer::Timer() : mStart(0), mStop(0)
 // initializes a started timer
 Timer::Timer(timerstart_t) : mStop(0)
 {
-	QueryPerformanceCounter((LARGE_INTEGER*)&mStart);
+	mStart = TimerTicks();
 }
 // starts the timer
 void Timer::Start()
 {
-	QueryPerformanceCounter((LARGE_INTEGER*)&mStart);
+	mStart = TimerTicks();
 }
 // stops the timer
 void Timer::Stop()
 {
-	QueryPerformanceCounter((LARGE_INTEGER*)&mStop);
+	mStop = TimerTicks();
 }
 // gets the elapsed time in seconds
 double Timer::Elapsed() const
@@ -36,7 +53,7 @@ double Timer::Elapsed() const
 // stops the timer and gets elapsed time in seconds
 double Timer::StopElapsed()
 {
-	QueryPerformanceCounter((LARGE_INTEGER*)&mStop);
+	mStop = TimerTicks();
 	return double(mStop - mStart) / mDFrequency;
 }
 
@@ -60,13 +77,12 @@ double TimeSampler::PrevSample()
 
 SpareTime::SpareTime(float timeLeft) : mSpareTime(timeLeft)
 {
-	QueryPerformanceCounter((LARGE_INTEGER*)&mStart);
+	mStart = TimerTicks();
 }
 
 float SpareTime::TimeRemaining() const
 {
-	long long stop;
-	QueryPerformanceCounter((LARGE_INTEGER*)&stop);
+	long long stop = TimerTicks();
 	float remaining = mSpareTime - (float(stop - mStart) / mFFrequency);
 	return remaining > 0.0f ? remaining : 0.0f;
 }
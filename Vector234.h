@@ -6,7 +6,7 @@
 #define VECTOR234_H
 
 
-#include "GL\glm\glm.hpp" // vec3, vec2
+#include "GL/glm/glm.hpp" // vec3, vec2
 #include <algorithm>
 using std::min;
 using std::max;
@@ -168,8 +168,8 @@ struct Vector3
 	inline Vector3() : x(0.0f), y(0.0f), z(0.0f) {}
 	inline Vector3(float v) : x(v), y(v), z(v) {}
 	inline Vector3(float x, float y, float z = 0.0f) : x(x), y(y), z(z) {}
-	inline Vector3(const float2& xy, float z) : xy(xy), z(z) {}
-	inline Vector3(float x, const float2& yz) : x(x), yz(yz) {}
+	inline Vector3(const float2& xy, float z) : x(xy.x), y(xy.y), z(z) {}
+	inline Vector3(float x, const float2& yz) : x(x), y(yz.x), z(yz.y) {}
 	inline Vector3(const float3& xyz) : xyz(xyz) {}
 	inline Vector3(const glm::vec3& v) : x(v.x), y(v.y), z(v.z) {}
 
@@ -281,13 +281,13 @@ struct Vector4
 
 
 	inline Vector4(const float2& xy, float z = 0.0f, float w = 1.0f) // xy, z, w
-		: xy(xy), z(z), w(w) {}
+		: x(xy.x), y(xy.y), z(z), w(w) {}
 	inline Vector4(float x, const float2& yz, float w = 1.0f) // x, yz, w
-		: x(x), yz(yz), w(w) {}
+		: x(x), y(yz.x), z(yz.y), w(w) {}
 	inline Vector4(float x, float y, const float2& zw) // x, y, zw
-		: x(x), y(y), zw(zw) {}
+		: x(x), y(y), z(zw.x), w(zw.y) {}
 	inline Vector4(const float2& xy, const float2& zw) // xy, zw
-		: xy(xy), zw(zw) {}
+		: x(xy.x), y(xy.y), z(zw.x), w(zw.y) {}
 
 	inline Vector4(const Vector2& xy, float z = 0.0f, float w = 1.0f) // xy, z, w
 		: x(xy.x), y(xy.y), z(z), w(w) {}
@@ -309,9 +309,9 @@ struct Vector4
 
 
 	inline Vector4(const float3& xyz, float w = 1.0f) // xyz, w
-		: xyz(xyz), w(w) {}
+		: x(xyz.x), y(xyz.y), z(xyz.z), w(w) {}
 	inline Vector4(float x, const float3& yzw) // x, yzw
-		: x(x), yzw(yzw) {}
+		: x(x), y(yzw.x), z(yzw.y), w(yzw.z) {}
 
 	inline Vector4(const Vector3& xyz, float w = 1.0f) // xyz, w
 		: x(xyz.x), y(xyz.y), z(xyz.z), w(w) {}
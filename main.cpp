@@ -289,6 +289,8 @@ void frame_enter(float deltaTime)
 bool spare_time(const SpareTime& spareTime)
 {
 	// we are waiting for vsync and have some extra time to waste
+	if (PathfinderTest)
+		return PathfinderTest::OnSpareTime(spareTime);
 
 	return false; // we didn't do anything
 }
@@ -3,10 +3,11 @@
 #include <vector>
 using std::vector;
 #include <assert.h>
+#include <string.h>
 
 struct node_heap
 {
-	typedef AstarNode* T;
+	typedef AstarState* T;
 	T*  Data;      // data buffer
 	int Size;      // number of used elements
 	int Capacity;  // total capacity
@@ -200,13 +201,13 @@ struct node_heap
 
 	bool is_heap() const
 	{
-		return std::is_heap(Data, Data + Size, [](AstarNode* a, AstarNode* b) {
+		return std::is_heap(Data, Data + Size, [](AstarState* a, AstarState* b) {
 			return a->FScore > b->FScore;
 		});
 	}
 	void make_heap()
 	{
-		std::make_heap(Data, Data + Size, [](AstarNode* a, AstarNode* b) {
+		std::make_heap(Data, Data + Size, [](AstarState* a, AstarState* b) {
 			return a->FScore > b->FScore;
 		});
 	}
@@ -217,7 +218,7 @@ struct node_heap
 
 struct node_vect
 {
-	typedef AstarNode* T;
+	typedef AstarState* T;
 	T*  Data;
 	int Size;
 	int Capacity;
@@ -388,6 +389,368 @@ struct node_vect
 
 
 
+/**
+ * An indexed 4-ary min-heap. Every node in the heap keeps its current
+ * position in AstarState::HeapIndex, so repos() and erase() are O(log n)
+ * without having to search for the node first.
+ */
+struct node_iheap
+{
+	typedef AstarState* T;
+	T*  Data;      // data buffer
+	int Size;      // number of used elements
+	int Capacity;  // total capacity
+
+	node_iheap() : Data(0), Size(0), Capacity(0)
+	{
+	}
+	node_iheap(int capacity) : Data(0), Size(0), Capacity(0)
+	{
+		reserve(capacity);
+	}
+	node_iheap(const node_iheap& other)          = delete; // NOCOPY
+	node_iheap& operator=(const node_iheap& rhs) = delete; // NOCOPY
+	~node_iheap()
+	{
+		if (Data) free(Data);
+	}
+	node_iheap(node_iheap&& other)
+	{
+		Data = other.Data, Size = other.Size, Capacity = other.Capacity;
+		other.Data = 0, other.Size = 0, other.Capacity = 0;
+	}
+	node_iheap& operator=(node_iheap&& fwd)
+	{
+		T* p = fwd.Data; int s = fwd.Size, c = fwd.Capacity;
+		fwd.Data = Data, fwd.Size = Size, fwd.Capacity = Capacity;
+		Data = p, Size = s, Capacity = c;
+		return *this;
+	}
+
+	void reserve(int capacity)
+	{
+		if (capacity > Capacity)
+		{
+			int cap = capacity;
+			if (int rem = cap % 8) // align up to 8
+				cap += 8 - rem;
+			Data = (T*)realloc(Data, sizeof(T)*(Capacity = cap));
+		}
+	}
+
+	__forceinline T& operator[](int index) { return Data[index]; }
+	__forceinline T operator[](int index) const { return Data[index]; }
+	__forceinline int size() const { return Size; }
+	__forceinline bool empty() const { return Size == 0; }
+	__forceinline void clear() { Size = 0; }
+
+	//// @brief Shifts the item upward as needed and updates HeapIndex of all moved items
+	//// @note  The item does not have to exist, so this also works as insert
+	static __forceinline void insert_up(T* ptr, int itemIndex, T item)
+	{
+		int current = itemIndex;
+		const int itemScore = item->FScore;
+
+		while (current > 0) // move upwards in the heap
+		{
+			int parent = (current - 1) >> 2; // parent = (i - 1)/4
+			T dataParent = ptr[parent];
+			if (dataParent->FScore <= itemScore)
+				break;
+			ptr[current] = dataParent; // demote parent to current index
+			dataParent->HeapIndex = current;
+			current = parent; // move upwards
+		}
+		ptr[current] = item; // write our value
+		item->HeapIndex = current;
+	}
+
+	//// @brief Shifts the item downward as needed and updates HeapIndex of all moved items
+	//// @note  The item does not have to exist, so this also works as insert
+	static __forceinline void insert_down(T* ptr, int size, int itemIndex, T item)
+	{
+		int current = itemIndex;
+		const int itemScore = item->FScore;
+
+		for (;;) // move downwards in the heap
+		{
+			int child = (current << 2) + 1; // first_child = i*4 + 1
+			if (child >= size)
+				break;
+
+			// select the best of the (up to) 4 children
+			int last = child + 4;
+			if (last > size) last = size;
+			int best = child;
+			int bestScore = ptr[child]->FScore;
+			for (++child; child < last; ++child)
+			{
+				int score = ptr[child]->FScore;
+				if (score < bestScore)
+					best = child, bestScore = score;
+			}
+
+			if (itemScore <= bestScore)
+				break;
+			T dataChild = ptr[best];
+			ptr[current] = dataChild; // promote child to new parent
+			dataChild->HeapIndex = current;
+			current = best; // move downwards
+		}
+		ptr[current] = item; // write the final value
+		item->HeapIndex = current;
+	}
+
+	void insert(T item)
+	{
+		int size = Size;
+		assert(size < Capacity);
+
+		insert_up(Data, size, item); // insert to back
+		++Size;
+	}
+
+	T pop()
+	{
+		T* ptr = Data;
+		T poppedItem = ptr[0];
+
+		// remove the last element and insert it to index 0
+		int size = --Size;
+		if (size) insert_down(ptr, size, 0, ptr[size]);
+		return poppedItem;
+	}
+
+	void erase(T eraseItem)
+	{
+		T* ptr = Data;
+		int current = eraseItem->HeapIndex;
+		assert(current < Size && ptr[current] == eraseItem);
+
+		// pop last item and replace current item with it
+		int size = --Size;
+		if (current == size)
+			return; // it was the last item
+		T lastItem = ptr[size];
+		if (lastItem->FScore < eraseItem->FScore)
+			insert_up(ptr, current, lastItem);
+		else
+			insert_down(ptr, size, current, lastItem);
+	}
+
+	// instead of erase/insert, this function simply repositions
+	// this item to a new correct index
+	void repos(T repoItem)
+	{
+		T* ptr = Data;
+		int current = repoItem->HeapIndex;
+		assert(current < Size && ptr[current] == repoItem);
+
+		// parent score must always be lower, otherwise heap will be invalid
+		if (current > 0 && ptr[(current - 1) >> 2]->FScore > repoItem->FScore)
+			insert_up(ptr, current, repoItem);
+		else
+			insert_down(ptr, Size, current, repoItem);
+	}
+
+	void print()
+	{
+		for (int i = 0; i < Size; ++i)
+			printf("%d ", Data[i]->FScore);
+		printf("\n");
+	}
+
+	bool is_heap() const
+	{
+		for (int i = 1; i < Size; ++i)
+			if (Data[(i - 1) >> 2]->FScore > Data[i]->FScore || Data[i]->HeapIndex != i)
+				return false;
+		return true;
+	}
+};
+
+
+
+
+/**
+ * A bucket queue for the small non-negative integer F-scores of PathfinderAstar.
+ * Every score has its own bucket (a singly linked list of entries), so insert and pop
+ * are amortized O(1) and independent of the open list size.
+ *
+ * repos() does not unlink the node, it simply adds a new entry to the new bucket.
+ * The stale entry is skipped by pop(), because its bucket no longer matches the
+ * node's FScore. This relies on FScore strictly decreasing on every repos().
+ *
+ * F is not guaranteed to be monotone (Manhattan*8 is not consistent with the
+ * diagonal gain of 11), so the min-cursor is moved back if a lower score is inserted.
+ */
+struct node_buckets
+{
+	typedef AstarState* T;
+	struct entry
+	{
+		T   node;
+		int next; // next entry in the same bucket, -1 if none
+	};
+
+	int*   Heads;      // first entry of every bucket, -1 if the bucket is empty
+	int    NumBuckets; // number of allocated buckets, FScore must be < NumBuckets
+	entry* Entries;    // entry pool, entries are only released by clear()
+	int    NumEntries; // number of used entries
+	int    Capacity;   // total entry capacity
+	int    MinKey;     // every bucket below this is empty
+	int    MaxKey;     // highest bucket touched since last clear()
+	int    Size;       // number of live nodes
+
+	node_buckets() : Heads(0), NumBuckets(0), Entries(0), NumEntries(0), Capacity(0), 
+		MinKey(0x7fffffff), MaxKey(-1), Size(0)
+	{
+	}
+	node_buckets(int capacity) : Heads(0), NumBuckets(0), Entries(0), NumEntries(0), Capacity(0), 
+		MinKey(0x7fffffff), MaxKey(-1), Size(0)
+	{
+		reserve(capacity);
+	}
+	node_buckets(const node_buckets& other)          = delete; // NOCOPY
+	node_buckets& operator=(const node_buckets& rhs) = delete; // NOCOPY
+	~node_buckets()
+	{
+		if (Heads)   free(Heads);
+		if (Entries) free(Entries);
+	}
+	node_buckets(node_buckets&& other)
+	{
+		Heads = other.Heads, NumBuckets = other.NumBuckets;
+		Entries = other.Entries, NumEntries = other.NumEntries, Capacity = other.Capacity;
+		MinKey = other.MinKey, MaxKey = other.MaxKey, Size = other.Size;
+		other.Heads = 0, other.NumBuckets = 0;
+		other.Entries = 0, other.NumEntries = 0, other.Capacity = 0;
+		other.MinKey = 0x7fffffff, other.MaxKey = -1, other.Size = 0;
+	}
+	node_buckets& operator=(node_buckets&& fwd)
+	{
+		int* h = fwd.Heads; int nb = fwd.NumBuckets;
+		entry* e = fwd.Entries; int ne = fwd.NumEntries, c = fwd.Capacity;
+		int mn = fwd.MinKey, mx = fwd.MaxKey, s = fwd.Size;
+		fwd.Heads = Heads, fwd.NumBuckets = NumBuckets;
+		fwd.Entries = Entries, fwd.NumEntries = NumEntries, fwd.Capacity = Capacity;
+		fwd.MinKey = MinKey, fwd.MaxKey = MaxKey, fwd.Size = Size;
+		Heads = h, NumBuckets = nb;
+		Entries = e, NumEntries = ne, Capacity = c;
+		MinKey = mn, MaxKey = mx, Size = s;
+		return *this;
+	}
+
+	void reserve(int capacity)
+	{
+		if (capacity > Capacity)
+		{
+			int cap = capacity;
+			if (int rem = cap % 8) // align up to 8
+				cap += 8 - rem;
+			Entries = (entry*)realloc(Entries, sizeof(entry)*(Capacity = cap));
+		}
+	}
+
+	// makes sure buckets [0, key] exist
+	void reserve_buckets(int key)
+	{
+		if (key >= NumBuckets)
+		{
+			int count = NumBuckets ? NumBuckets * 2 : 1024;
+			if (count <= key) count = key + 1;
+			if (int rem = count % 64) // align up to 64
+				count += 64 - rem;
+			Heads = (int*)realloc(Heads, sizeof(int) * count);
+			memset(Heads + NumBuckets, 0xff, sizeof(int) * (count - NumBuckets)); // -1
+			NumBuckets = count;
+		}
+	}
+
+	__forceinline int size() const { return Size; }
+	__forceinline bool empty() const { return Size == 0; }
+
+	void clear()
+	{
+		if (MaxKey >= 0) // only reset the buckets we actually touched
+		{
+			int first = MinKey < MaxKey ? MinKey : MaxKey;
+			memset(Heads + first, 0xff, sizeof(int) * (MaxKey - first + 1));
+		}
+		NumEntries = 0;
+		MinKey = 0x7fffffff;
+		MaxKey = -1;
+		Size   = 0;
+	}
+
+	// adds a new entry for the item into the bucket of its current FScore
+	__forceinline void push_entry(T item)
+	{
+		const int key = item->FScore;
+		assert(key >= 0);
+		if (key >= NumBuckets)
+			reserve_buckets(key);
+		if (NumEntries == Capacity)
+			reserve(Capacity + 4 + (Capacity >> 1)); // += 50%
+
+		int e = NumEntries++;
+		Entries[e].node = item;
+		Entries[e].next = Heads[key];
+		Heads[key] = e;
+		if (key < MinKey) MinKey = key;
+		if (key > MaxKey) MaxKey = key;
+	}
+
+	void insert(T item)
+	{
+		push_entry(item);
+		++Size;
+	}
+
+	T pop()
+	{
+		assert(Size > 0);
+		int* heads = Heads;
+		int key = MinKey;
+		for (;;)
+		{
+			int e = heads[key];
+			if (e == -1) // empty bucket, move the cursor forward
+			{
+				++key;
+				continue;
+			}
+			heads[key] = Entries[e].next;
+			T item = Entries[e].node;
+			if (item->FScore == key) // skip stale entries left behind by repos()
+			{
+				MinKey = key;
+				--Size;
+				return item;
+			}
+		}
+	}
+
+	// instead of erase/insert, this function simply adds a new entry for the item
+	// and leaves the old entry to be discarded by pop()
+	void repos(T repoItem)
+	{
+		push_entry(repoItem);
+	}
+
+	void print()
+	{
+		for (int key = MinKey; key <= MaxKey; ++key)
+			for (int e = Heads[key]; e != -1; e = Entries[e].next)
+				if (Entries[e].node->FScore == key)
+					printf("%d ", key);
+		printf("\n");
+	}
+};
+
+
+
+
 
 
 
@@ -451,6 +814,14 @@ template<class T> struct PfVector
 		}
 	}
 
+	// swaps the buffers of two vectors; no allocation
+	inline void swap(PfVector& other)
+	{
+		T* data = Data; Data = other.Data; other.Data = data;
+		int size = Size; Size = other.Size; other.Size = size;
+		int cap = Capacity; Capacity = other.Capacity; other.Capacity = cap;
+	}
+
 	// pop the last element and return it
 	void pop(T& out)
 	{
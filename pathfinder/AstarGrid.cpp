@@ -1,99 +1,751 @@
 #include "AstarGrid.h"
+#include "PfThreadPool.h"
+
+const int AstarGrid::NeighborX[8] = { 0, 1, 1, 1, 0,-1,-1,-1 };
+const int AstarGrid::NeighborY[8] = { 1, 1, 0,-1,-1,-1, 0, 1 };
 
 void AstarGrid::destroy()
 {
+	if (Planes)
+	{
+		free(Planes);
+		Planes = 0;
+	}
 	if (Nodes)
 	{
 		delete[] Nodes;
 		Nodes = 0;
-		Width = 0;
-		Height = 0;
 	}
+	if (Costs)
+	{
+		free(Costs);
+		Costs = 0;
+	}
+	if (Clearance)
+	{
+		free(Clearance);
+		Clearance = 0;
+	}
+	MinCost = 1;
+	Width  = 0;
+	Height = 0;
+	NumPlanes = 0;
+	PlaneSizes.clear();
+	FreePlanes.clear();
 }
 
-void AstarGrid::create(int width, int height, const byte* initData)
+void AstarGrid::create(int width, int height, const byte* initData, AstarGridMode mode, const byte* costData,
+                       PfThreadPool* workers)
 {
+	destroy();
 	int count = width * height;
 	Width  = width;
 	Height = height;
-	Nodes  = new AstarNode[count];
-
-	for (int y = 0; y < height; ++y)
-	for (int x = 0; x < width;  ++x) 
-	{
-		const int i = (y * width) + x;
-		AstarNode& n = Nodes[i];
-		n.FScore = 0;
-		n.GScore = 0;
-		n.HScore = 0;
-		n.Closed = false;
-		n.Plane  = initData[i] < 128 ? 1 : 0; // black tiles: plane1, other uninit
-		n.X      = x;
-		n.Y      = y;
-		n.OpenID = 0;
-		n.Prev   = 0;
-		n.NumLinks = 0;
+	Mode   = mode;
+	Planes = (ushort*)malloc(sizeof(ushort) * count);
+	for (int i = 0; i < count; ++i)
+		Planes[i] = initData[i] < 128 ? 1 : 0; // black tiles: plane1, other uninit
+
+	if (costData)
+	{
+		Costs   = (byte*)malloc(count);
+		MinCost = 255;
+		for (int i = 0; i < count; ++i)
+		{
+			byte cost = costData[i] ? costData[i] : 1;
+			Costs[i] = cost;
+			if (cost < MinCost) // blocked cells too, set_blocked() can open them up later
+				MinCost = cost;
+		}
 	}
+
 	// initialize plane ID-s and grid links
-	NumPlanes = fill_planes(count, 2);
+	NumPlanes = fill_planes(2, workers);
+	count_planes();
+	if (mode == GRID_LINKED)
+		create_links(workers);
 }
 
-int AstarGrid::fill_planes(int count, int firstPlane)
+// union-find over cell indices. Roots are linked under the lower index,
+// so the root of every region is its first cell
+static __forceinline int find_root(const int* parent, int i)
 {
-	PfVector<AstarNode*> open;
-	open.reserve((Width + Height) * 2);
-	for (int i = 0; i < count; ++i)
+	while (parent[i] != i)
+		i = parent[i];
+	return i;
+}
+
+static __forceinline int find_compress(int* parent, int i)
+{
+	int root = find_root(parent, i);
+	while (parent[i] != root)
+	{
+		int next = parent[i];
+		parent[i] = root;
+		i = next;
+	}
+	return root;
+}
+
+static __forceinline void unite(int* parent, int a, int b)
+{
+	a = find_compress(parent, a);
+	b = find_compress(parent, b);
+	if      (a < b) parent[b] = a;
+	else if (b < a) parent[a] = b;
+}
+
+int AstarGrid::fill_planes(int firstPlane, PfThreadPool* workers)
+{
+	ushort* planes = Planes;
+	const int width = Width, height = Height, count = width * height;
+	int* parent = (int*)malloc(sizeof(int) * count);
+
+	int numStrips = 1;
+	if (workers && workers->size() > 1 && count >= MinParallelCells)
+		numStrips = workers->size() * 4; // a few strips per worker, regions aren't spread evenly
+	if (numStrips > height)
+		numStrips = height;
+	const int rowsPerStrip = (height + numStrips - 1) / numStrips;
+	numStrips = (height + rowsPerStrip - 1) / rowsPerStrip;
+	PfVector<int> roots; // regions first seen in every strip, then the first plane ID of every strip
+	for (int strip = 0; strip < numStrips; ++strip)
+		roots.push_back(0);
+
+	auto forEachStrip = [&](const PfThreadPool::Task& task)
+	{
+		if (numStrips > 1) workers->parallel_for(numStrips, task);
+		else               task(0, 0);
+	};
+	auto stripEnd = [&](int strip) { return (strip + 1) * rowsPerStrip < height ? (strip + 1) * rowsPerStrip : height; };
+
+	// pass 1: label every strip on its own. Only cells of the strip are touched
+	forEachStrip([&](int /*worker*/, int strip)
+	{
+		const int y0 = strip * rowsPerStrip, y1 = stripEnd(strip);
+		for (int y = y0; y < y1; ++y)
+		{
+			const bool up = y > y0; // the row above belongs to this strip
+			for (int x = 0; x < width; ++x)
+			{
+				int i = y * width + x;
+				if (planes[i])
+					continue;
+				parent[i] = i;
+
+				// N touches NW and NE, and W touches NW, so they were already joined with them
+				if (up && !planes[i - width])
+				{
+					unite(parent, i, i - width);
+					continue;
+				}
+				if (up && x < width - 1 && !planes[i - width + 1]) unite(parent, i, i - width + 1);
+				if (x > 0 && !planes[i - 1])                         unite(parent, i, i - 1);
+				else if (up && x > 0 && !planes[i - width - 1])      unite(parent, i, i - width - 1);
+			}
+		}
+		// parents always have lower indices, so a forward sweep points every cell straight at its root
+		for (int i = y0 * width, end = y1 * width; i < end; ++i)
+			if (!planes[i])
+				parent[i] = parent[parent[i]];
+	});
+
+	// pass 2: join the regions across the boundary rows, only [width] cells per strip
+	for (int strip = 1; strip < numStrips; ++strip)
+	{
+		const int y = strip * rowsPerStrip;
+		for (int x = 0; x < width; ++x)
+		{
+			int i = y * width + x;
+			if (planes[i])
+				continue;
+			for (int nx = x > 0 ? x - 1 : x, nx1 = x < width - 1 ? x + 1 : x; nx <= nx1; ++nx)
+			{
+				int n = i - width + nx - x;
+				if (!planes[n])
+					unite(parent, i, n);
+			}
+		}
+	}
+
+	// pass 3: number the regions in order of their first cell and write the plane ID-s
+	forEachStrip([&](int /*worker*/, int strip)
+	{
+		int numRoots = 0;
+		for (int i = strip * rowsPerStrip * width, end = stripEnd(strip) * width; i < end; ++i)
+			if (!planes[i] && parent[i] == i)
+				++numRoots;
+		roots[strip] = numRoots;
+	});
+	int next = firstPlane;
+	for (int strip = 0; strip < numStrips; ++strip)
 	{
-		if (!Nodes[i].Plane) 
-			quick_fill(open, &Nodes[i], firstPlane++);
+		int first = next;
+		next += roots[strip];
+		roots[strip] = first;
 	}
-	return firstPlane;
+	forEachStrip([&](int /*worker*/, int strip)
+	{
+		int plane = roots[strip];
+		for (int i = strip * rowsPerStrip * width, end = stripEnd(strip) * width; i < end; ++i)
+			if (!planes[i] && parent[i] == i)
+			{
+				planes[i] = ushort(plane < OverflowPlane ? plane : OverflowPlane);
+				++plane;
+			}
+	});
+	forEachStrip([&](int /*worker*/, int strip) // roots are labeled now, every other cell takes the label of its root
+	{
+		for (int i = strip * rowsPerStrip * width, end = stripEnd(strip) * width; i < end; ++i)
+			if (!planes[i])
+				planes[i] = planes[find_root(parent, i)];
+	});
+
+	free(parent);
+	return next < OverflowPlane ? next : OverflowPlane;
 }
 
-void AstarGrid::quick_fill(PfVector<AstarNode*>& open, AstarNode* firstNode, int plane)
+void AstarGrid::create_links(PfThreadPool* workers)
 {
-	// this is actually similar to the A* algo
-	AstarNode* node = firstNode;
+	const int count = Width * Height;
+	if (!Nodes)
+		Nodes = new AstarNode[count];
+
+	if (!workers || workers->size() == 1 || count < MinParallelCells)
+	{
+		for (int y = 0; y < Height; ++y)
+			link_row(y);
+		return;
+	}
+	// nodes only point at their neighbors, so rows are fully independent
+	const int height = Height;
+	const int rowsPerTask = 16;
+	workers->parallel_for((height + rowsPerTask - 1) / rowsPerTask, [=](int /*worker*/, int task)
+	{
+		int yEnd = (task + 1) * rowsPerTask < height ? (task + 1) * rowsPerTask : height;
+		for (int y = task * rowsPerTask; y < yEnd; ++y)
+			link_row(y);
+	});
+}
+
+void AstarGrid::link_row(int y)
+{
+	const int width = Width;
+	if (y == 0 || y == Height - 1 || width < 3)
+	{
+		for (int x = 0; x < width; ++x)
+			link_node(x, y);
+		return;
+	}
+	link_node(0, y);
+	link_node(width - 1, y);
+
+	// same order as link_node(): N, NE, E, SE, S, SW, W, NW
+	const int offsets[AstarNode::MaxLinks] = { width, width + 1, 1, 1 - width, -width, -width - 1, -1, width - 1 };
+	static const int gains[AstarNode::MaxLinks] = { 8, 11, 8, 11, 8, 11, 8, 11 };
+	const ushort* planes = Planes;
+	const byte* costs = Costs;
+	AstarNode* nodes  = Nodes;
+	for (int x = 1, cell = y * width + 1; x < width - 1; ++x, ++cell)
+	{
+		AstarNode& node = nodes[cell];
+		node.X = x;
+		node.Y = y;
+		if (planes[cell] == 1)
+		{
+			node.NumLinks = 0;
+			continue;
+		}
+		node.NumLinks = AstarNode::MaxLinks;
+		if (costs)
+		{
+			for (int j = 0; j < AstarNode::MaxLinks; ++j)
+			{
+				node.Links[j].node = &nodes[cell + offsets[j]];
+				node.Links[j].gain = link_gain(costs[cell], costs[cell + offsets[j]], gains[j]);
+			}
+		}
+		else
+		{
+			for (int j = 0; j < AstarNode::MaxLinks; ++j)
+			{
+				node.Links[j].node = &nodes[cell + offsets[j]];
+				node.Links[j].gain = gains[j];
+			}
+		}
+	}
+}
+
+void AstarGrid::link_node(int x, int y)
+{
+	AstarNode& node = Nodes[y * Width + x];
+	node.X = x;
+	node.Y = y;
+	node.NumLinks = 0;
+	if (Planes[y * Width + x] == 1)
+		return; // collision nodes are never expanded, so they don't need links
+
+	const byte* costs = Costs;
+	auto add = [&](int nx, int ny, int gain) {
+		if (AstarNode* link = get(nx, ny))
+		{
+			if (costs) // precomputed, so the linked search doesn't need to know about terrain
+				gain = link_gain(costs[y * Width + x], costs[ny * Width + nx], gain);
+			node.Links[node.NumLinks++] = { link, gain };
+		}
+	};
+	add(x    , y + 1, 8 ); // N
+	add(x + 1, y + 1, 11); // NE
+	add(x + 1, y    , 8 ); // E
+	add(x + 1, y - 1, 11); // SE
+	add(x    , y - 1, 8 ); // S
+	add(x - 1, y - 1, 11); // SW
+	add(x - 1, y    , 8 ); // W
+	add(x - 1, y + 1, 11); // NW
+}
+
+
+
+
+void AstarGrid::count_planes()
+{
+	PlaneSizes.clear();
+	FreePlanes.clear();
+	for (uint i = 0; i < NumPlanes; ++i)
+		PlaneSizes.push_back(0);
+	for (int i = 0, count = Width * Height; i < count; ++i)
+		if (Planes[i] != OverflowPlane)
+			++PlaneSizes[Planes[i]];
+}
+
+void AstarGrid::relabel_planes()
+{
+	for (int i = 0, count = Width * Height; i < count; ++i)
+		if (Planes[i] != 1) Planes[i] = 0;
+	NumPlanes = fill_planes(2);
+	count_planes();
+}
+
+int AstarGrid::alloc_plane()
+{
+	int plane;
+	if (!FreePlanes.empty())
+	{
+		FreePlanes.pop(plane);
+		return plane;
+	}
+	if (NumPlanes >= OverflowPlane)
+		return OverflowPlane;
+	PlaneSizes.push_back(0);
+	return NumPlanes++;
+}
+
+void AstarGrid::shrink_plane(int plane, int count)
+{
+	if (plane == 1 || plane == OverflowPlane)
+		return;
+	if ((PlaneSizes[plane] -= count) == 0)
+		FreePlanes.push_back(plane);
+}
+
+int AstarGrid::relabel(int cell, int from, int to, PfVector<int>& stack)
+{
+	ushort* planes = Planes;
+	const int width = Width, height = Height;
+	int numRelabeled = 1;
+	planes[cell] = to;
+	stack.clear();
 	while (true)
 	{
-		auto add = [&open, plane, node](AstarNode* link, int gain) {
-			bool addlink = true;
-			if (int count = node->NumLinks) {
-				AstarLink* links = node->Links;
-				for (int i = 0; i < count; ++i)
-					if (links[i].node == link) { // link already exists?
-						addlink = false;
-						break;
+		int x = cell % width, y = cell / width;
+		int x0 = x > 0 ? x - 1 : x, x1 = x < width  - 1 ? x + 1 : x;
+		int y0 = y > 0 ? y - 1 : y, y1 = y < height - 1 ? y + 1 : y;
+		for (int ny = y0; ny <= y1; ++ny)
+		for (int nx = x0; nx <= x1; ++nx)
+		{
+			int n = ny * width + nx;
+			if (planes[n] == from)
+			{
+				planes[n] = to;
+				stack.push_back(n);
+				++numRelabeled;
+			}
+		}
+
+		if (stack.empty())
+			break;
+		stack.pop(cell);
+	}
+	return numRelabeled;
+}
+
+bool AstarGrid::set_blocked(int x, int y, int w, int h, bool blocked)
+{
+	int x0 = x < 0 ? 0 : x, x1 = x + w > Width  ? Width  : x + w;
+	int y0 = y < 0 ? 0 : y, y1 = y + h > Height ? Height : y + h;
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	// update the cells themselves
+	int numChanged = 0;
+	for (int cy = y0; cy < y1; ++cy)
+	for (int cx = x0; cx < x1; ++cx)
+	{
+		int cell = cy * Width + cx;
+		int plane = Planes[cell];
+		if (blocked == (plane == 1))
+			continue;
+		if (blocked)
+		{
+			shrink_plane(plane, 1);
+			Planes[cell] = 1;
+		}
+		else Planes[cell] = 0; // assigned below
+		++numChanged;
+	}
+	if (!numChanged)
+		return false;
+
+	if (Nodes) // only the changed nodes gain or lose links, neighbors link to all cells anyway
+	{
+		for (int cy = y0; cy < y1; ++cy)
+		for (int cx = x0; cx < x1; ++cx)
+			link_node(cx, cy);
+	}
+
+	// walkable cells around and inside the rect are the only ones whose plane can change
+	PfVector<int> cells;
+	int rx0 = x0 > 0 ? x0 - 1 : x0, rx1 = x1 < Width  ? x1 : x1 - 1;
+	int ry0 = y0 > 0 ? y0 - 1 : y0, ry1 = y1 < Height ? y1 : y1 - 1;
+	for (int cy = ry0; cy <= ry1; ++cy)
+	for (int cx = rx0; cx <= rx1; ++cx)
+	{
+		bool inside = x0 <= cx && cx < x1 && y0 <= cy && cy < y1;
+		int cell = cy * Width + cx;
+		if (Planes[cell] != 1 && (!inside || !blocked))
+			cells.push_back(cell);
+	}
+
+	if (blocked)
+	{
+		// the surrounding cells of a plane might have been connected only through the rect
+		PfVector<int> seedPlanes, seeds;
+		for (int i = 0; i < cells.size(); ++i)
+			seedPlanes.push_back(Planes[cells[i]]);
+		for (int i = 0; i < cells.size(); ++i)
+		{
+			int plane = seedPlanes[i];
+			if (plane == 0)
+				continue; // already handled
+			seeds.clear();
+			for (int j = i; j < cells.size(); ++j)
+			{
+				if (seedPlanes[j] == plane)
+				{
+					seeds.push_back(cells[j]);
+					seedPlanes[j] = 0;
+				}
+			}
+			if (seeds.size() >= 2 && plane != OverflowPlane && !split_plane(plane, seeds.Data, seeds.size()))
+				break; // all planes were relabeled from scratch
+		}
+		return true;
+	}
+
+	// unblocked cells join all the planes around them into the largest one
+	int target = 0;
+	for (int i = 0; i < cells.size(); ++i)
+	{
+		int plane = Planes[cells[i]];
+		if (plane > 1 && (target == 0 || plane == OverflowPlane || 
+			(target != OverflowPlane && PlaneSizes[plane] > PlaneSizes[target])))
+			target = plane;
+	}
+	if (target == 0)
+		target = alloc_plane();
+
+	PfVector<int> stack;
+	for (int i = 0; i < cells.size(); ++i)
+	{
+		int plane = Planes[cells[i]];
+		if (plane == target)
+			continue;
+		int count = relabel(cells[i], plane, target, stack);
+		if (plane != 0)
+			shrink_plane(plane, count);
+		if (target != OverflowPlane)
+			PlaneSizes[target] += count;
+	}
+	return true;
+}
+/**
+ * One flood of split_plane(). Floods that meet are joined with union-find
+ */
+struct PlaneFlood
+{
+	PfVector<int> Cells; // visited cells, Cells[Head..] are still waiting to be expanded
+	int Head;
+	int Root;            // union-find parent flood
+	int Alive;           // number of unfinished floods in this set, only valid for roots
+};
+
+static int FindRoot(PlaneFlood* floods, int i)
+{
+	while (floods[i].Root != i)
+		i = floods[i].Root = floods[floods[i].Root].Root;
+	return i;
+}
+
+bool AstarGrid::split_plane(int plane, const int* seeds, int numSeeds)
+{
+	if (NumPlanes + numSeeds > OverflowPlane)
+	{
+		relabel_planes(); // out of plane ID-s, so compact all planes
+		return false;
+	}
+
+	// every flood marks its cells with its own temporary plane ID
+	const int base = NumPlanes;
+	NumPlanes += numSeeds;
+	for (int i = 0; i < numSeeds; ++i)
+		PlaneSizes.push_back(0);
+
+	PlaneFlood* floods = new PlaneFlood[numSeeds];
+	for (int i = 0; i < numSeeds; ++i)
+	{
+		floods[i].Cells.push_back(seeds[i]);
+		floods[i].Head  = 0;
+		floods[i].Root  = i;
+		floods[i].Alive = 1;
+		Planes[seeds[i]] = base + i;
+	}
+
+	// expand all floods one cell at a time, until at most one set of joined floods 
+	// is unfinished. The finished sets are the disconnected pieces of the plane,
+	// so the work is bounded by the size of the smaller pieces
+	ushort* planes = Planes;
+	const int width = Width, height = Height;
+	int numAlive = numSeeds;
+	while (numAlive > 1)
+	{
+		for (int i = 0; i < numSeeds && numAlive > 1; ++i)
+		{
+			PlaneFlood& f = floods[i];
+			if (f.Head == f.Cells.size())
+				continue;
+
+			int cell = f.Cells[f.Head++];
+			int x = cell % width, y = cell / width;
+			int x0 = x > 0 ? x - 1 : x, x1 = x < width  - 1 ? x + 1 : x;
+			int y0 = y > 0 ? y - 1 : y, y1 = y < height - 1 ? y + 1 : y;
+			for (int ny = y0; ny <= y1; ++ny)
+			for (int nx = x0; nx <= x1; ++nx)
+			{
+				int n = ny * width + nx;
+				int p = planes[n];
+				if (p == plane)
+				{
+					planes[n] = base + i;
+					f.Cells.push_back(n);
+				}
+				else if (base <= p && p < base + numSeeds)
+				{
+					int a = FindRoot(floods, i), b = FindRoot(floods, p - base);
+					if (a != b) // met another flood, so these pieces are connected
+					{
+						floods[b].Root   = a;
+						floods[a].Alive += floods[b].Alive;
+						--numAlive;
 					}
+				}
 			}
-			if (addlink)
-				node->Links[node->NumLinks++] = { link, gain }; // add
-			if (!link->Plane)
+
+			if (f.Head == f.Cells.size() && --floods[FindRoot(floods, i)].Alive == 0)
+				--numAlive; // this whole set is finished
+		}
+	}
+
+	// the unfinished set (or the largest one if all finished) keeps the original plane ID
+	int keep = -1, keepSize = -1;
+	for (int i = 0; i < numSeeds; ++i)
+	{
+		if (FindRoot(floods, i) != i)
+			continue;
+		int size = 0;
+		for (int j = 0; j < numSeeds; ++j)
+			if (FindRoot(floods, j) == i) size += floods[j].Cells.size();
+		if (floods[i].Alive > 0) size = 0x7fffffff;
+		if (size > keepSize) keep = i, keepSize = size;
+	}
+
+	int numMoved = 0;
+	for (int i = 0; i < numSeeds; ++i)
+	{
+		int root = FindRoot(floods, i);
+		int label = root == keep ? plane : base + root;
+		const PfVector<int>& cells = floods[i].Cells;
+		for (int j = 0; j < cells.size(); ++j)
+			planes[cells[j]] = label;
+		if (root != keep)
+		{
+			PlaneSizes[label] += cells.size();
+			numMoved += cells.size();
+		}
+	}
+	shrink_plane(plane, numMoved);
+
+	// temporary ID-s that didn't become a new plane are given back
+	while (NumPlanes > uint(base) && PlaneSizes[NumPlanes - 1] == 0)
+		--NumPlanes, --PlaneSizes.Size;
+	for (int i = base; i < int(NumPlanes); ++i)
+		if (PlaneSizes[i] == 0)
+			FreePlanes.push_back(i);
+
+	delete[] floods;
+	return true;
+}
+
+void AstarGrid::create_clearance()
+{
+	if (!Clearance)
+		Clearance = (byte*)malloc(size_t(Width) * Height);
+	update_clearance(0, 0, Width, Height);
+}
+
+void AstarGrid::update_clearance(int x, int y, int w, int h)
+{
+	const int C = MaxClearance;
+	// cells that can change: the edit expanded by C
+	int ix0 = x - C > 0 ? x - C : 0, ix1 = x + w + C < Width  ? x + w + C : Width;
+	int iy0 = y - C > 0 ? y - C : 0, iy1 = y + h + C < Height ? y + h + C : Height;
+	// obstacles that can affect them: another C around
+	int ox0 = ix0 - C > 0 ? ix0 - C : 0, ox1 = ix1 + C < Width  ? ix1 + C : Width;
+	int oy0 = iy0 - C > 0 ? iy0 - C : 0, oy1 = iy1 + C < Height ? iy1 + C : Height;
+	if (ix0 >= ix1 || iy0 >= iy1)
+		return;
+
+	const int ow = ox1 - ox0, oh = oy1 - oy0;
+	byte* dist = (byte*)malloc(size_t(ow) * oh);
+	for (int cy = 0; cy < oh; ++cy)
+	{
+		const ushort* planes = &Planes[(oy0 + cy) * Width + ox0];
+		byte* d = &dist[cy * ow];
+		for (int cx = 0; cx < ow; ++cx)
+			d[cx] = planes[cx] == 1 ? 0 : byte(C);
+	}
+
+	// two-pass chamfer transform with unit steps to all 8 neighbors gives the exact chessboard distance.
+	// the grid border counts as an obstacle, the edge of the window doesn't (those cells are only read)
+	const int outside = 0, unknown = C;
+	auto at = [&](int cx, int cy) -> int
+	{
+		if (cx < 0 || cx >= ow || cy < 0 || cy >= oh)
+		{
+			int gx = ox0 + cx, gy = oy0 + cy;
+			return (gx < 0 || gx >= Width || gy < 0 || gy >= Height) ? outside : unknown;
+		}
+		return dist[cy * ow + cx];
+	};
+	for (int cy = 0; cy < oh; ++cy)
+	for (int cx = 0; cx < ow; ++cx)
+	{
+		byte& d = dist[cy * ow + cx];
+		if (!d) continue;
+		int v = d;
+		int n;
+		if ((n = at(cx - 1, cy)     + 1) < v) v = n;
+		if ((n = at(cx - 1, cy - 1) + 1) < v) v = n;
+		if ((n = at(cx,     cy - 1) + 1) < v) v = n;
+		if ((n = at(cx + 1, cy - 1) + 1) < v) v = n;
+		d = byte(v);
+	}
+	for (int cy = oh - 1; cy >= 0; --cy)
+	for (int cx = ow - 1; cx >= 0; --cx)
+	{
+		byte& d = dist[cy * ow + cx];
+		if (!d) continue;
+		int v = d;
+		int n;
+		if ((n = at(cx + 1, cy)     + 1) < v) v = n;
+		if ((n = at(cx + 1, cy + 1) + 1) < v) v = n;
+		if ((n = at(cx,     cy + 1) + 1) < v) v = n;
+		if ((n = at(cx - 1, cy + 1) + 1) < v) v = n;
+		d = byte(v);
+	}
+
+	for (int cy = iy0; cy < iy1; ++cy)
+		memcpy(&Clearance[cy * Width + ix0], &dist[(cy - oy0) * ow + (ix0 - ox0)], ix1 - ix0);
+	free(dist);
+}
+
+int AstarGrid::dial_sweep(int source, int* cost, PfVector<int>* buckets) const
+{
+	const ushort* planes = Planes;
+	const int width  = Width;
+	const int height = Height;
+	memset(cost, 0x7f, sizeof(int) * width * height); // Unreachable
+
+	cost[source] = 0;
+	buckets[0].push_back(source);
+	int pending = 1, settled = 0;
+	for (int current = 0; pending; ++current)
+	{
+		PfVector<int>& bucket = buckets[current % 12];
+		for (int i = 0; i < bucket.size(); ++i)
+		{
+			int cell = bucket[i];
+			if (cost[cell] != current) // stale entry, a cheaper cost was found later
+				continue;
+			++settled;
+			int x = cell % width, y = cell / width;
+			for (int j = 0; j < 8; ++j)
 			{
-				link->Plane = plane;
-				open.push_back(link);
+				int nx = x + NeighborX[j], ny = y + NeighborY[j];
+				if (nx < 0 || width <= nx || ny < 0 || height <= ny)
+					continue;
+				int n = ny * width + nx;
+				int c = current + ((j & 1) ? 11 : 8);
+				if (planes[n] == 1 || c >= cost[n])
+					continue;
+				cost[n] = c;
+				buckets[c % 12].push_back(n);
+				++pending;
 			}
-		};
-		
-		int x = node->X, y = node->Y;
-		if (AstarNode* N  = get(x    , y + 1)) add(N,  8);
-		if (AstarNode* NE = get(x + 1, y + 1)) add(NE, 11);
-		if (AstarNode* E  = get(x + 1, y    )) add(E,  8);
-		if (AstarNode* SE = get(x + 1, y - 1)) add(SE, 11);
-		if (AstarNode* S  = get(x    , y - 1)) add(S,  8);
-		if (AstarNode* SW = get(x - 1, y - 1)) add(SW, 11);
-		if (AstarNode* W  = get(x - 1, y    )) add(W,  8);
-		if (AstarNode* NW = get(x - 1, y + 1)) add(NW, 11);
-
-		if (open.empty())
-			break;
-		open.pop(node); // pop last element
+		}
+		pending -= bucket.size();
+		bucket.clear();
+	}
+	return settled;
+}
+
+size_t AstarGrid::bytes() const
+{
+	size_t count = size_t(Width) * Height;
+	size_t total = sizeof(ushort) * count;
+	if (Nodes) total += sizeof(AstarNode) * count;
+	if (Costs) total += count;
+	if (Clearance) total += count;
+	return total;
+}
+
+
+void AstarGrid::grayscale_costs(const byte* initData, int count, byte* outCosts)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		int gray = initData[i];
+		outCosts[i] = gray < 128 ? 1 : byte(1 + (255 - gray) / 32); // blocked cells get the cheapest cost
 	}
 }
 
 
 AstarNode* AstarGrid::get(int x, int y)
 {
-	if (x < 0 || Width <= x || y < 0 || Height <= y) return NULL; // world bounds checkin'
+	if (!Nodes || x < 0 || Width <= x || y < 0 || Height <= y) return NULL; // world bounds checkin'
+	return &Nodes[y * Width + x];
+}
+const AstarNode* AstarGrid::get(int x, int y) const
+{
+	if (!Nodes || x < 0 || Width <= x || y < 0 || Height <= y) return NULL; // world bounds checkin'
 	return &Nodes[y * Width + x];
 }
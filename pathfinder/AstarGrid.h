@@ -1,18 +1,52 @@
 #pragma once
 #include "AstarContainers.h"
 
+struct PfThreadPool;
+
 //typedef node_heap PfOpenList;
-typedef node_vect PfOpenList;
+//typedef node_vect PfOpenList;
+//typedef node_buckets PfOpenList;
+typedef node_iheap PfOpenList;
+
+enum AstarGridMode
+{
+	GRID_LINKED,  // every cell is an AstarNode with explicit links (~100 bytes per cell)
+	GRID_COMPACT, // only a plane ID per cell, neighbors are computed from coordinates (2 bytes per cell)
+};
 
 struct AstarGrid
 {
-	AstarNode* Nodes;	// Array of all nodes
+	ushort* Planes;		// plane ID of every cell, collision plane is always 1
+	AstarNode* Nodes;	// Array of all nodes, only allocated in GRID_LINKED mode
+	byte* Costs;		// terrain cost multiplier of every cell (1 = cheapest), NULL for uniform-cost grids
+	int MinCost;		// lowest cost of any cell, scales the heuristics so they stay admissible
+	byte* Clearance;	// chessboard distance of every cell to the nearest blocked cell or the grid border,
+						// capped at MaxClearance. 0 for blocked cells. NULL until create_clearance()
+	AstarGridMode Mode;
 
 	int Width, Height;	// size of this 'grid world'
-	//AstarNode* Goal;	// goal of the path (destination)
-	uint NumPlanes;		// number of planes in this grid
+	uint NumPlanes;		// number of planes in this grid (next unused plane ID)
+	PfVector<int> PlaneSizes; // number of cells in each plane, indexed by plane ID
+	PfVector<int> FreePlanes; // plane ID-s that became empty after edits and can be reused
+
+	// plane ID shared by all planes after running out of 16-bit plane ID-s.
+	// cells in this plane can't be rejected early, but the search itself is still correct
+	static const ushort OverflowPlane = 0xffff;
+
+	// grids with fewer cells are labeled and linked on the calling thread, the pool isn't worth waking up
+	static const int MinParallelCells = 256 * 256;
+
+	// Clearance cap, so an edit only updates the cells within MaxClearance of it. Agents up to 2*MaxClearance-1 cells
+	static const int MaxClearance = 32;
 
-	inline AstarGrid() : Nodes(0), Width(0), Height(0) {}
+	// cost of the cells dial_sweep() can't reach, memset friendly
+	static const int Unreachable = 0x7f7f7f7f;
+
+	// neighbor offsets of every direction index: N, NE, E, SE, S, SW, W, NW. Odd indices are diagonal
+	static const int NeighborX[8];
+	static const int NeighborY[8];
+
+	inline AstarGrid() : Planes(0), Nodes(0), Costs(0), MinCost(1), Clearance(0), Mode(GRID_LINKED), Width(0), Height(0), NumPlanes(0) {}
 	inline ~AstarGrid() { destroy(); }
 
 	/**
@@ -24,17 +58,144 @@ struct AstarGrid
 	/**
 	 * @brief Initializes AstarGrid from 2D 1-channel bitmap data
 	 *        with the specified dimensions
+	 * @param mode GRID_LINKED allocates explicit nodes and links, 
+	 *             GRID_COMPACT only stores the plane ID-s
+	 * @param costData Optional terrain cost multiplier of every cell, for example from grayscale_costs().
+	 *                 Values are clamped to [1, 255]. If NULL, every link costs 8 or 11
+	 * @param workers Optional thread pool for labeling the planes and linking the nodes in parallel
+	 * @note Process(), ProcessALT() and ProcessBidirectional() honor the terrain costs.
+	 *       JPS, Theta*, HPA*, flow fields, D* Lite and the landmark sweeps assume a uniform cost grid
 	 */
-	void create(int width, int height, const byte* initData);
-	int fill_planes(int count, int firstPlane);
-	void quick_fill(PfVector<AstarNode*>& open, AstarNode* node, int plane);
+	void create(int width, int height, const byte* initData, AstarGridMode mode = GRID_LINKED,
+	            const byte* costData = NULL, PfThreadPool* workers = NULL);
 
+	/**
+	 * @brief Converts a grayscale map to terrain costs: white (255) costs 1 and every 32 
+	 *        levels darker cost 1 more, up to 4 at the blocking threshold of 128.
+	 *        For example white roads, light gray grass and dark gray swamps
+	 * @param outCosts Receives [count] costs
+	 */
+	static void grayscale_costs(const byte* initData, int count, byte* outCosts);
 
-	//// @brief This is only used during init methods
-	AstarNode* get(int x, int y);
+	/**
+	 * @brief Gain of the link between two neighboring cells: the average cost of both cells
+	 *        times the straight (8) or diagonal (11) gain. Symmetric, so forward and 
+	 *        backward searches see the same costs. Uniform cells give exactly 8 and 11
+	 */
+	static inline int link_gain(int costA, int costB, int gain)
+	{
+		return (gain * (costA + costB) + 1) >> 1;
+	}
+
+	/**
+	 * @brief Assigns a unique plane ID to every connected region of unassigned (0) cells.
+	 *        Two-pass union-find labeling: every strip of rows is labeled on its own, then
+	 *        the strips are joined along their boundary rows. Plane ID-s are handed out in
+	 *        order of the first cell of every region, so the result doesn't depend on the strips
+	 * @param workers Optional thread pool, the strips are labeled in parallel
+	 * @return Next free plane ID
+	 */
+	int fill_planes(int firstPlane, PfThreadPool* workers = NULL);
+
+	/**
+	 * @brief Links every walkable node to its 8 neighbors (GRID_LINKED only)
+	 * @param workers Optional thread pool, rows are linked in parallel
+	 */
+	void create_links(PfThreadPool* workers = NULL);
+
+	/**
+	 * @brief Links all nodes of a row. Nodes off the border skip the bounds checks of link_node()
+	 */
+	void link_row(int y);
+
+	/**
+	 * @brief Links a single node to its 8 neighbors, or clears its links if it's blocked
+	 */
+	void link_node(int x, int y);
+
+	/**
+	 * @brief Blocks or unblocks all cells in [x, y, x+w, y+h) and updates the plane ID-s
+	 *        incrementally: unblocking merges the neighboring planes into the largest one,
+	 *        blocking floods the surrounding cells in lockstep and only relabels the 
+	 *        smaller pieces if the plane was split
+	 * @return TRUE if any cell changed
+	 */
+	bool set_blocked(int x, int y, int w, int h, bool blocked);
+
+	/**
+	 * @brief Computes the Clearance of every cell with a chessboard distance transform
+	 */
+	void create_clearance();
+
+	/**
+	 * @brief Updates the Clearance around the edited cells [x, y, x+w, y+h).
+	 *        Only cells within MaxClearance of the edit can change, and their distances only 
+	 *        depend on the cells within another MaxClearance, so only that window is transformed
+	 */
+	void update_clearance(int x, int y, int w, int h);
+
+	/**
+	 * @brief Dijkstra from a single cell over the whole grid with straight gain 8 and diagonal gain 11.
+	 *        Every pending cost is within 11 of the current one, so a ring of 12 buckets
+	 *        (Dial's algorithm) replaces the priority queue. Terrain costs are ignored
+	 * @param cost Receives the cost of every cell, Unreachable if there is no path
+	 * @param buckets 12 empty scratch buckets: cells with cost % 12 == index. Left empty
+	 * @return Number of cells reached, including the source
+	 */
+	int dial_sweep(int source, int* cost, PfVector<int>* buckets) const;
+
+	/**
+	 * @return Clearance needed by an agent of agentSize cells: its footprint is the smallest odd
+	 *         square covering it, centered on the cell. Every walkable cell has clearance >= 1
+	 */
+	static inline int clearance_for(int agentSize)
+	{
+		return agentSize / 2 + 1;
+	}
+
+	/**
+	 * @return TRUE if the footprint of an agent of agentSize cells centered on the cell is free
+	 * @note Requires create_clearance() for agents larger than one cell
+	 */
+	inline bool fits(int cell, int agentSize) const
+	{
+		if (agentSize <= 1)
+			return Planes[cell] != 1;
+		assert(Clearance && "create_clearance() before searching for large agents");
+		return Clearance[cell] >= clearance_for(agentSize);
+	}
 
 	/**
-	 * @brief Opens the specified node. Expects a gain parameter
+	 * @brief Recalculates all plane ID-s and plane sizes from scratch
 	 */
-	bool open(AstarNode* prev, AstarNode& n, int gain);
-};
\ No newline at end of file
+	void relabel_planes();
+
+	// counts PlaneSizes from the current Planes
+	void count_planes();
+	// @return An unused plane ID or OverflowPlane
+	int alloc_plane();
+	// moves a cell count out of a plane, recycling its ID if it becomes empty
+	void shrink_plane(int plane, int count);
+	// relabels the connected region of [from] cells starting at cell to [to]. @return Number of cells relabeled
+	int relabel(int cell, int from, int to, PfVector<int>& stack);
+	// checks if the seed cells of a plane are still connected, giving the disconnected pieces new plane ID-s
+	// @return FALSE if all planes had to be relabeled from scratch
+	bool split_plane(int plane, const int* seeds, int numSeeds);
+
+	/** @return Total number of bytes allocated by this grid */
+	size_t bytes() const;
+
+	/** @return Cell index of [x, y] or -1 if it's outside of the grid */
+	inline int index(int x, int y) const
+	{
+		if (x < 0 || Width <= x || y < 0 || Height <= y) return -1; // world bounds checkin'
+		return y * Width + x;
+	}
+	inline int x_of(int index) const { return index % Width; }
+	inline int y_of(int index) const { return index / Width; }
+	inline bool walkable(int index) const { return Planes[index] != 1; }
+
+	//// @brief Only available in GRID_LINKED mode, otherwise returns NULL
+	AstarNode* get(int x, int y);
+	const AstarNode* get(int x, int y) const;
+};
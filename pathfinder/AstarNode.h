@@ -9,22 +9,31 @@ struct AstarLink
 	int gain;        // distance score gain if this link is traversed
 };
 
+/**
+ * Static topology of a single grid cell in GRID_LINKED mode. Nodes are never modified 
+ * during a search, so one grid can be shared by any number of concurrent searches.
+ * @note The plane ID of the node is stored in AstarGrid::Planes
+ */
 struct AstarNode 
 {
-	int FScore;			// F = H(manhattan) + GScore score to destination
-	int HScore;         // heuristic score - manhattan method
-	uint OpenID;        // ID of an 'open' node, this is used to check if we've opened this node or not
 	int X, Y;			// the X, Y position in the world
-	AstarNode* Prev;	// previous node in this path
-
-	bool Closed;		// true if this node has been closed
-	byte Plane;			// plane of this Node, collision plane is always 1
-	byte _Dummy1;
-	byte _Dummy2;
-	int GScore;			// accumulated sum of G values g=(10 or 14
-
 
 	static const int MaxLinks = 8;
 	int NumLinks;		// number of active links
 	AstarLink Links[MaxLinks];
 };
+
+/**
+ * Mutable per-search state of a single grid cell. Every SearchContext has its own
+ * packed array of these, indexed the same way as AstarGrid::Planes
+ */
+struct AstarState
+{
+	int FScore;			// F = H(manhattan) + GScore score to destination
+	int GScore;			// accumulated sum of G values g=(8 or 11)
+	uint OpenID;        // ID of the search that opened this node, | ClosedBit if it's also closed
+	int Prev;			// index of the previous node in this path, -1 if none
+	int HeapIndex;		// current index in the open list (only maintained by node_iheap)
+
+	static const uint ClosedBit = 0x80000000;
+};
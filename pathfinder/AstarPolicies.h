@@ -0,0 +1,448 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef ASTAR_POLICIES_H
+#define ASTAR_POLICIES_H
+
+#include "PathfinderAstar.h"
+#include <math.h>
+
+/**
+ * Compile-time policies of PathfinderAstar::ProcessPolicy(). Every combination is its own
+ * instantiation of AstarExpand(), so unused features cost nothing in the inner loop:
+ *   Heuristic:    ManhattanHeuristic, OctileHeuristic, EuclideanHeuristic, LandmarkHeuristic
+ *   Connectivity: Connect8, Connect4
+ *   Trace:        NoTrace, ExploredTrace
+ *   Cost:         UniformCost, TerrainCost - selected from AstarGrid::Costs once per search
+ *   Clearance:    ClearanceNeighbors - selected for agents larger than one cell
+ * @note Only include this header to instantiate ProcessPolicy() with your own policies
+ */
+
+
+// octile distance with straight gain 8 and diagonal gain 11. Unlike the manhattan
+// estimate it never overestimates, so the searches using it find optimal paths
+__forceinline int octile(int dx, int dy)
+{
+	if (dx < 0) dx = -dx;
+	if (dy < 0) dy = -dy;
+	return dx < dy ? (dy << 3) + dx * 3 : (dx << 3) + dy * 3;
+}
+
+
+/**
+ * Cost policy of a grid without terrain costs: links cost 8 or 11
+ */
+struct UniformCost
+{
+	inline UniformCost(const AstarGrid& /*grid*/) {}
+
+	__forceinline int gain(int /*from*/, int /*to*/, int gain) const { return gain; }
+	__forceinline int scale(int heuristic) const { return heuristic; }
+};
+
+/**
+ * Cost policy of a grid with AstarGrid::Costs. Selected once per search,
+ * so the uniform-cost searches don't pay for it in their inner loops
+ */
+struct TerrainCost
+{
+	const byte* Costs;
+	int MinCost;
+
+	inline TerrainCost(const AstarGrid& grid) : Costs(grid.Costs), MinCost(grid.MinCost) {}
+
+	__forceinline int gain(int from, int to, int gain) const
+	{
+		return AstarGrid::link_gain(Costs[from], Costs[to], gain);
+	}
+	// every link costs at least MinCost times its uniform gain
+	__forceinline int scale(int heuristic) const { return heuristic * MinCost; }
+};
+
+
+// all 8 neighbors, diagonals cost 11
+struct Connect8 { static const bool Diagonals = true; };
+
+// only the 4 straight neighbors
+struct Connect4 { static const bool Diagonals = false; };
+
+
+/**
+ * Enumerates the neighbors of a cell through the explicit AstarNode links (GRID_LINKED)
+ * @note The link gains already include the terrain costs
+ */
+template<class Connectivity> struct LinkedNeighbors
+{
+	const AstarNode* Nodes;
+
+	inline LinkedNeighbors(const AstarGrid& grid) : Nodes(grid.Nodes) {}
+
+	// calls func(index, x, y, gain) for every neighbor of the cell
+	template<class Func> __forceinline void for_each(int cell, Func& func) const
+	{
+		const AstarNode* nodes = Nodes;
+		const AstarNode& node  = nodes[cell];
+		const AstarLink* link  = node.Links;
+		const AstarLink* elink = link + node.NumLinks;
+		for (; link != elink; ++link)
+		{
+			const AstarNode* n = link->node;
+			if (!Connectivity::Diagonals && n->X != node.X && n->Y != node.Y)
+				continue; // compiled out with Connect8
+			func(int(n - nodes), n->X, n->Y, link->gain);
+		}
+	}
+};
+
+/**
+ * Computes the 8 neighbors of a cell from its coordinates (GRID_COMPACT)
+ * @note Uses the same neighbor order as AstarGrid::create_links()
+ */
+template<class Cost, class Connectivity> struct ImplicitNeighbors
+{
+	int Width, Height;
+	Cost cost;
+
+	inline ImplicitNeighbors(const AstarGrid& grid) : Width(grid.Width), Height(grid.Height), cost(grid) {}
+
+	// calls func(index, x, y, gain) for every neighbor of the cell
+	template<class Func> __forceinline void for_each(int cell, Func& func) const
+	{
+		const bool d = Connectivity::Diagonals;
+		const int w = Width;
+		const int y = cell / w, x = cell - y * w;
+		if (0 < x && x < w - 1 && 0 < y && y < Height - 1) // not on the border, skip bounds checks
+		{
+			func(cell + w,     x,     y + 1, cost.gain(cell, cell + w,     8 )); // N
+			if (d)
+				func(cell + w + 1, x + 1, y + 1, cost.gain(cell, cell + w + 1, 11)); // NE
+			func(cell + 1,     x + 1, y,     cost.gain(cell, cell + 1,     8 )); // E
+			if (d)
+				func(cell - w + 1, x + 1, y - 1, cost.gain(cell, cell - w + 1, 11)); // SE
+			func(cell - w,     x,     y - 1, cost.gain(cell, cell - w,     8 )); // S
+			if (d)
+				func(cell - w - 1, x - 1, y - 1, cost.gain(cell, cell - w - 1, 11)); // SW
+			func(cell - 1,     x - 1, y,     cost.gain(cell, cell - 1,     8 )); // W
+			if (d)
+				func(cell + w - 1, x - 1, y + 1, cost.gain(cell, cell + w - 1, 11)); // NW
+			return;
+		}
+		const bool n = y < Height - 1, e = x < w - 1, s = y > 0, west = x > 0;
+		if (n)              func(cell + w,     x,     y + 1, cost.gain(cell, cell + w,     8 )); // N
+		if (d && n && e)    func(cell + w + 1, x + 1, y + 1, cost.gain(cell, cell + w + 1, 11)); // NE
+		if (e)              func(cell + 1,     x + 1, y,     cost.gain(cell, cell + 1,     8 )); // E
+		if (d && s && e)    func(cell - w + 1, x + 1, y - 1, cost.gain(cell, cell - w + 1, 11)); // SE
+		if (s)              func(cell - w,     x,     y - 1, cost.gain(cell, cell - w,     8 )); // S
+		if (d && s && west) func(cell - w - 1, x - 1, y - 1, cost.gain(cell, cell - w - 1, 11)); // SW
+		if (west)           func(cell - 1,     x - 1, y,     cost.gain(cell, cell - 1,     8 )); // W
+		if (d && n && west) func(cell + w - 1, x - 1, y + 1, cost.gain(cell, cell + w - 1, 11)); // NW
+	}
+};
+
+
+/**
+ * Skips the neighbors with too little AstarGrid::Clearance for the footprint of a large agent.
+ * Wraps the neighbors of the grid mode, so a single grid serves agents of every size
+ * @note Requires AstarGrid::create_clearance()
+ */
+template<class Neighbors> struct ClearanceNeighbors
+{
+	Neighbors neighbors;
+	const byte* Clearance;
+	int MinClearance;
+
+	inline ClearanceNeighbors(const AstarGrid& grid, int agentSize)
+		: neighbors(grid), Clearance(grid.Clearance), MinClearance(AstarGrid::clearance_for(agentSize)) {}
+
+	// calls func(index, x, y, gain) for every neighbor the agent fits on
+	template<class Func> __forceinline void for_each(int cell, Func& func) const
+	{
+		const byte* clearance = Clearance;
+		const int minClearance = MinClearance;
+		auto fits = [&](int index, int x, int y, int gain)
+		{
+			if (clearance[index] >= minClearance)
+				func(index, x, y, gain);
+		};
+		neighbors.for_each(cell, fits);
+	}
+};
+
+
+/**
+ * Default Process() heuristic: (abs(distX) + abs(distY))*8
+ * @note Overestimates diagonal paths, so it's fast but the paths are not always optimal
+ */
+template<class Cost> struct ManhattanHeuristic
+{
+	int GoalX, GoalY;
+	Cost cost;
+
+	inline ManhattanHeuristic(const PathfinderAstar& pf, int end)
+		: GoalX(pf.Grid.x_of(end)), GoalY(pf.Grid.y_of(end)), cost(pf.Grid) {}
+
+	__forceinline int operator()(int /*index*/, int x, int y) const
+	{
+		int HScore = GoalX - x, diffY = GoalY - y;
+		if (HScore < 0) HScore = -HScore;
+		if (diffY  < 0) diffY = -diffY;
+		HScore += diffY;
+		return cost.scale(HScore << 3);
+	}
+};
+
+/**
+ * Octile distance: exact on an empty 8-connected grid, so the paths are optimal
+ */
+template<class Cost> struct OctileHeuristic
+{
+	int GoalX, GoalY;
+	Cost cost;
+
+	inline OctileHeuristic(const PathfinderAstar& pf, int end)
+		: GoalX(pf.Grid.x_of(end)), GoalY(pf.Grid.y_of(end)), cost(pf.Grid) {}
+
+	__forceinline int operator()(int /*index*/, int x, int y) const
+	{
+		return cost.scale(octile(GoalX - x, GoalY - y));
+	}
+};
+
+/**
+ * Straight line distance, rounded down. A diagonal step of 11 is shorter than 8*sqrt(2),
+ * so the distance is scaled by 11/sqrt(2) per cell to never overestimate.
+ * Weaker than octile on 8-connected grids
+ */
+template<class Cost> struct EuclideanHeuristic
+{
+	int GoalX, GoalY;
+	Cost cost;
+
+	inline EuclideanHeuristic(const PathfinderAstar& pf, int end)
+		: GoalX(pf.Grid.x_of(end)), GoalY(pf.Grid.y_of(end)), cost(pf.Grid) {}
+
+	__forceinline int operator()(int index, int x, int y) const
+	{
+		int dx = GoalX - x, dy = GoalY - y;
+		return cost.scale(int(7.7781746f * sqrtf(float(dx * dx + dy * dy))));
+	}
+};
+
+/**
+ * ALT heuristic: the highest landmark triangle inequality bound, but never below the octile distance
+ * @note Requires PathfinderAstar::Landmarks
+ */
+template<class Cost> struct LandmarkHeuristic
+{
+	const LandmarkTable& Table;
+	const ushort* GoalDist; // landmark costs of the goal, looked up once per search
+	int GoalX, GoalY;
+	Cost cost; // landmark costs are uniform-cost lower bounds, scaled like the octile distance
+
+	inline LandmarkHeuristic(const PathfinderAstar& pf, int end)
+		: Table(pf.Landmarks), GoalDist(pf.Landmarks.get(end)),
+		  GoalX(pf.Grid.x_of(end)), GoalY(pf.Grid.y_of(end)), cost(pf.Grid) {}
+
+	__forceinline int operator()(int index, int x, int y) const
+	{
+		int h   = octile(GoalX - x, GoalY - y);
+		int alt = Table.lower_bound(Table.get(index), GoalDist);
+		return cost.scale(alt > h ? alt : h);
+	}
+};
+
+
+// records nothing, the calls compile away
+struct NoTrace
+{
+	__forceinline void link(const PathfinderAstar& /*pf*/, int /*from*/, int /*to*/) const {}
+};
+
+// records every opened or reopened link as a line pair [from, to] in screen coordinates
+struct ExploredTrace
+{
+	PfVector<Vector2>* Explored;
+
+	inline ExploredTrace(PfVector<Vector2>* explored) : Explored(explored) {}
+
+	__forceinline void link(const PathfinderAstar& pf, int from, int to) const
+	{
+		Explored->push_back(pf.ToScreenCoordCentered(from));
+		Explored->push_back(pf.ToScreenCoordCentered(to));
+	}
+};
+
+
+/**
+ * Starts a search: the start node is closed and becomes the first head to expand
+ */
+template<class OpenListType>
+void AstarBegin(SearchContextT<OpenListType>& ctx, int start)
+{
+	AstarState* s = &ctx.States[start];
+	s->FScore = 0;
+	s->GScore = 0;
+	s->OpenID = ctx.OpenID | AstarState::ClosedBit;
+	s->Prev   = -1;
+}
+
+/**
+ * Expands nodes of a search started with AstarBegin(), until the end is reached, 
+ * the open list runs out or maxExpansions nodes were expanded. The search counters
+ * of the context accumulate, so a search can be resumed from the returned head.
+ * @return The end if it was reached, -1 if there is no path, otherwise the next head to expand
+ * @warning This function is heavily optimized using profile guided optimization hints
+ *          and cache stall info. If you plan to optimize/change this function, please
+ *          use a profiler to measure changes
+ */
+template<class Heuristic, class Neighbors, class Trace, class OpenListType>
+int AstarExpand(const PathfinderAstar& pf, SearchContextT<OpenListType>& ctx, const Neighbors& neighbors,
+                int head, int end, const Trace& trace, int maxExpansions)
+{
+	const ushort* planes = pf.Grid.Planes;
+	AstarState* states   = ctx.States;
+	OpenListType& openList = ctx.Open;
+	const uint openID   = ctx.OpenID;
+	const uint closedID = openID | AstarState::ClosedBit;
+	int numOpened   = 0;
+	int numReopened = 0;
+	int numExpanded = 0;
+	int maxDepth    = ctx.MaxDepth;
+	const Heuristic heuristic(pf, end);
+
+	AstarState* headState = &states[head];
+	int prev       = -1;
+	int headGScore = 0;
+
+	auto open = [&](int index, int x, int y, int gain)
+	{
+		if (planes[index] == 1 || index == prev)
+			return; // collision plane or circular reference
+
+		AstarState* s = &states[index];
+		const uint sid = s->OpenID;
+		if (sid == closedID)
+			return; // don't touch it if it's CLOSED
+
+		if (sid == openID) // we have opened this Node before
+		{
+			int gscore = headGScore + gain; // new gain score
+			if (gscore >= s->GScore)
+				return; // if the new gain is worse, then don't touch it
+
+			s->FScore += gscore - s->GScore; // HScore stays the same
+			s->GScore  = gscore;
+			s->Prev    = head;
+
+			//// @note reopened:
+			++numOpened;
+			++numReopened;
+			openList.repos(s); // reposition item
+		}
+		else
+		{
+			int HScore = heuristic(index, x, y);
+			int GScore = headGScore + gain;
+			s->GScore = GScore;
+			s->FScore = HScore + GScore;
+			s->Prev   = head;
+			s->OpenID = openID;
+
+			//// @note first open:
+			++numOpened;
+			openList.insert(s);
+		}
+
+		int size = openList.size();
+		if (size > maxDepth) maxDepth = size;
+
+		trace.link(pf, head, index);
+	};
+
+	while (head != end)
+	{
+		prev       = headState->Prev;
+		headGScore = headState->GScore;
+		neighbors.for_each(head, open);
+
+		// after inserting into the sorted list we get the heuristically best node available
+		if (openList.empty())
+		{
+			head = -1;
+			break;
+		}
+
+		headState = openList.pop();
+		headState->OpenID = closedID;
+		head = int(headState - states);
+		++numExpanded;
+		if (--maxExpansions == 0)
+			break; // out of budget, resume from this head
+	}
+
+	ctx.NumOpened   += numOpened;
+	ctx.NumReopened += numReopened;
+	ctx.NumExpanded += numExpanded;
+	ctx.MaxDepth     = maxDepth;
+	if (head == end || head == -1)
+		openList.clear(); // resets the pool
+	return head;
+}
+
+
+/**
+ * Selects the clearance policy once per search: agents of a single cell don't test the clearance
+ */
+template<class Heuristic, class Neighbors, class Trace, class OpenListType>
+__forceinline int AstarExpandSized(const PathfinderAstar& pf, SearchContextT<OpenListType>& ctx,
+                                   int head, int end, const Trace& trace, int maxExpansions, int agentSize)
+{
+	if (agentSize > 1)
+		return AstarExpand<Heuristic>(pf, ctx, ClearanceNeighbors<Neighbors>(pf.Grid, agentSize), head, end, trace, maxExpansions);
+	return AstarExpand<Heuristic>(pf, ctx, Neighbors(pf.Grid), head, end, trace, maxExpansions);
+}
+
+/**
+ * Selects the neighbor and cost policies of the grid once per search
+ */
+template<template<class> class Heuristic, class Connectivity, class Trace, class OpenListType>
+int AstarDispatch(const PathfinderAstar& pf, SearchContextT<OpenListType>& ctx,
+                  int head, int end, const Trace& trace, int maxExpansions, int agentSize = 1)
+{
+	typedef LinkedNeighbors<Connectivity> Linked;
+	if (pf.Grid.Costs)
+		return pf.Grid.Mode == GRID_LINKED
+			? AstarExpandSized<Heuristic<TerrainCost>, Linked>(pf, ctx, head, end, trace, maxExpansions, agentSize)
+			: AstarExpandSized<Heuristic<TerrainCost>, ImplicitNeighbors<TerrainCost, Connectivity>>(pf, ctx, head, end, trace, maxExpansions, agentSize);
+	return pf.Grid.Mode == GRID_LINKED
+		? AstarExpandSized<Heuristic<UniformCost>, Linked>(pf, ctx, head, end, trace, maxExpansions, agentSize)
+		: AstarExpandSized<Heuristic<UniformCost>, ImplicitNeighbors<UniformCost, Connectivity>>(pf, ctx, head, end, trace, maxExpansions, agentSize);
+}
+
+
+template<template<class> class Heuristic, class Connectivity, class Trace, class OpenListType>
+bool PathfinderAstar::ProcessPolicy(SearchContextT<OpenListType>& ctx, int start, int end,
+                                    PfVector<Vector2>& outPath, const Trace& trace, int agentSize) const
+{
+	ctx.begin_search(); // with 1000 * 60 pathfinds per second, this will overflow in: ~4 years
+	const ushort* planes = Grid.Planes;
+	if (planes[start] != planes[end] || planes[start] == 1)
+		return false; // no possible path between these two, or collision planes(1)
+	if (agentSize > 1 && (!Grid.fits(start, agentSize) || !Grid.fits(end, agentSize)))
+		return false; // the agent doesn't fit on the start or the end
+
+	AstarBegin(ctx, start);
+	if (AstarDispatch<Heuristic, Connectivity>(*this, ctx, start, end, trace, -1, agentSize) != end)
+		return false; // a budget of -1 never runs out
+
+	// construct the out path [end .. start]
+	const AstarState* states = ctx.States;
+	int index = end;
+	do {
+		outPath.push_back(ToScreenCoordCentered(index));
+	} while ((index = states[index].Prev) != -1);
+	return true;
+}
+
+#endif // ASTAR_POLICIES_H
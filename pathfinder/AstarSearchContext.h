@@ -0,0 +1,93 @@
+#pragma once
+#include "AstarGrid.h"
+
+/**
+ * Mutable state of a single A* search over a shared, read-only AstarGrid.
+ * Process() only writes into the SearchContext, so N threads can search 
+ * the same grid concurrently as long as every thread has its own context.
+ *
+ * Node states are stamped with the OpenID of the search that touched them last,
+ * so nothing has to be cleared between searches.
+ */
+template<class OpenList> struct SearchContextT
+{
+	OpenList    Open;        // open list of this search
+	AstarState* States;      // per-node search state, indexed the same as AstarGrid::Planes
+	int  NumStates;          // number of allocated States
+	uint OpenID;             // unique ID of the current search, always < AstarState::ClosedBit
+	int  NumOpened;          // number of grids opened by the last search
+	int  NumReopened;        // number of grids reopened by the last search
+	int  NumExpanded;        // number of grids closed by the last search
+	int  MaxDepth;           // max openlist depth
+
+	inline SearchContextT() 
+		: States(0), NumStates(0), OpenID(0), NumOpened(0), NumReopened(0), NumExpanded(0), MaxDepth(0)
+	{
+	}
+	inline ~SearchContextT() { destroy(); }
+	SearchContextT(const SearchContextT& other)          = delete; // NOCOPY
+	SearchContextT& operator=(const SearchContextT& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Allocates search state for all nodes of the grid
+	 * @note  States are calloc-ed, so untouched pages of huge grids are never committed
+	 * @param openListCapacity Capacity to reserve for the open list
+	 */
+	void create(const AstarGrid& grid, int openListCapacity)
+	{
+		int count = grid.Width * grid.Height;
+		if (count != NumStates)
+		{
+			if (States) free(States);
+			States    = (AstarState*)calloc(count, sizeof(AstarState));
+			NumStates = count;
+		}
+		else if (OpenID) // reused, clear the old stamps
+		{
+			memset(States, 0, sizeof(AstarState) * count);
+		}
+		OpenID = 0;
+		Open.clear();
+		Open.reserve(openListCapacity);
+	}
+	inline void create(const AstarGrid& grid)
+	{
+		create(grid, (grid.Width + grid.Height) * 4);
+	}
+
+	/** @return Total number of bytes allocated by this context */
+	inline size_t bytes() const
+	{
+		return sizeof(AstarState) * NumStates;
+	}
+
+	void destroy()
+	{
+		if (States)
+		{
+			free(States);
+			States    = 0;
+			NumStates = 0;
+		}
+	}
+
+	/**
+	 * @brief Prepares the context for a new search
+	 * @return Unique OpenID for the new search
+	 */
+	uint begin_search()
+	{
+		NumOpened   = 0;
+		NumReopened = 0;
+		NumExpanded = 0;
+		Open.clear();
+		if (++OpenID == AstarState::ClosedBit) // OpenID overflow, all old stamps have to be cleared
+		{
+			memset(States, 0, sizeof(AstarState) * NumStates);
+			OpenID = 1;
+		}
+		return OpenID;
+	}
+};
+
+typedef SearchContextT<PfOpenList> SearchContext;
@@ -0,0 +1,100 @@
+#include "CollisionMask.h"
+
+
+void CollisionMask::create(const AstarGrid& grid)
+{
+	destroy();
+	Width       = grid.Width;
+	Height      = grid.Height;
+	RowWords    = (Width  + 63) >> 6;
+	ColumnWords = (Height + 63) >> 6;
+	Rows    = (unsigned __int64*)calloc(size_t(RowWords) * Height, sizeof(unsigned __int64));
+	Columns = (unsigned __int64*)calloc(size_t(ColumnWords) * Width, sizeof(unsigned __int64));
+	update(grid, 0, 0, Width, Height);
+}
+
+void CollisionMask::destroy()
+{
+	if (Rows)    free(Rows),    Rows    = 0;
+	if (Columns) free(Columns), Columns = 0;
+	Width = Height = 0;
+	RowWords = ColumnWords = 0;
+}
+
+void CollisionMask::update(const AstarGrid& grid, int x, int y, int w, int h)
+{
+	int x0 = x < 0 ? 0 : x, x1 = x + w > Width  ? Width  : x + w;
+	int y0 = y < 0 ? 0 : y, y1 = y + h > Height ? Height : y + h;
+	for (int cy = y0; cy < y1; ++cy)
+	for (int cx = x0; cx < x1; ++cx)
+	{
+		unsigned __int64& row = Rows[cy * RowWords + (cx >> 6)];
+		unsigned __int64& col = Columns[cx * ColumnWords + (cy >> 6)];
+		unsigned __int64 rowBit = 1ULL << (cx & 63);
+		unsigned __int64 colBit = 1ULL << (cy & 63);
+		if (grid.Planes[cy * Width + cx] == 1)
+			row |= rowBit, col |= colBit;
+		else
+			row &= ~rowBit, col &= ~colBit;
+	}
+}
+
+
+bool CollisionMask::any_set(const unsigned __int64* bits, int first, int last)
+{
+	int w0 = first >> 6, w1 = last >> 6;
+	unsigned __int64 m0 = ~0ULL << (first & 63);
+	unsigned __int64 m1 = ~0ULL >> (63 - (last & 63));
+	if (w0 == w1)
+		return (bits[w0] & m0 & m1) != 0;
+	if (bits[w0] & m0)
+		return true;
+	for (int i = w0 + 1; i < w1; ++i)
+		if (bits[i])
+			return true;
+	return (bits[w1] & m1) != 0;
+}
+
+
+/**
+ * Tests a line that moves at least as much along its major axis [a] as along its minor axis [b].
+ * On minor line j the line covers the major offsets whose cell intervals overlap
+ * the part of the line between j - 0.5 and j + 0.5, which is a single span:
+ *   first = floor(((2j-1)*da - db) / 2db) + 1
+ *   last  = ceil (((2j+1)*da + db) / 2db) - 1
+ * A line exactly through a cell corner belongs to neither of the side cells.
+ * @param lines Bit lines along the major axis, wordsPerLine words each
+ */
+static bool ClearLine(const unsigned __int64* lines, int wordsPerLine, int a0, int b0, int a1, int b1)
+{
+	int da = a1 - a0, db = b1 - b0;
+	int sa = da < 0 ? -1 : 1, sb = db < 0 ? -1 : 1;
+	if (da < 0) da = -da;
+	if (db < 0) db = -db;
+
+	if (db == 0)
+		return !CollisionMask::any_set(lines + b0 * wordsPerLine, a0 < a1 ? a0 : a1, a0 < a1 ? a1 : a0);
+
+	const int db2 = db << 1;
+	for (int j = 0; j <= db; ++j)
+	{
+		int first = j == 0  ? 0  : ((2 * j - 1) * da - db) / db2 + 1;
+		int last  = j == db ? da : ((2 * j + 1) * da + db + db2 - 1) / db2 - 1;
+		if (last > da) last = da;
+		int lo = sa > 0 ? a0 + first : a0 - last;
+		int hi = sa > 0 ? a0 + last  : a0 - first;
+		if (CollisionMask::any_set(lines + (b0 + sb * j) * wordsPerLine, lo, hi))
+			return false;
+	}
+	return true;
+}
+
+bool CollisionMask::line_of_sight(int x0, int y0, int x1, int y1) const
+{
+	int dx = x1 - x0, dy = y1 - y0;
+	if (dx < 0) dx = -dx;
+	if (dy < 0) dy = -dy;
+	return dx >= dy
+		? ClearLine(Rows,    RowWords,    x0, y0, x1, y1)
+		: ClearLine(Columns, ColumnWords, y0, x0, y1, x1);
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef COLLISION_MASK_H
+#define COLLISION_MASK_H
+
+#include "AstarGrid.h"
+
+/**
+ * Bit-packed copy of the collision cells of an AstarGrid for fast line-of-sight tests.
+ * The mask is kept both row-major and column-major, so the cells a line covers on every
+ * row (or column, for steep lines) are always a contiguous span of bits that is tested
+ * a whole 64-bit word at a time.
+ * @note 2 bits per cell
+ */
+struct CollisionMask
+{
+	unsigned __int64* Rows;    // bit x of row y is set if [x, y] is blocked
+	unsigned __int64* Columns; // bit y of column x is set if [x, y] is blocked
+	int Width, Height;
+	int RowWords;              // number of 64-bit words per row
+	int ColumnWords;           // number of 64-bit words per column
+
+	inline CollisionMask() : Rows(0), Columns(0), Width(0), Height(0), RowWords(0), ColumnWords(0) {}
+	inline ~CollisionMask() { destroy(); }
+	CollisionMask(const CollisionMask& other)          = delete; // NOCOPY
+	CollisionMask& operator=(const CollisionMask& rhs) = delete; // NOCOPY
+
+	void create(const AstarGrid& grid);
+	void destroy();
+
+	/**
+	 * @brief Copies the collision state of the cells in [x, y, x+w, y+h) from the grid
+	 */
+	void update(const AstarGrid& grid, int x, int y, int w, int h);
+
+	/** @return Total number of bytes allocated by this mask */
+	inline size_t bytes() const
+	{
+		return sizeof(unsigned __int64) * (size_t(RowWords) * Height + size_t(ColumnWords) * Width);
+	}
+
+	inline bool blocked(int x, int y) const
+	{
+		return (Rows[y * RowWords + (x >> 6)] >> (x & 63)) & 1;
+	}
+
+	/**
+	 * @brief Tests if the straight line between the centers of two cells only crosses free cells.
+	 *        A line through the exact corner of 4 cells steps diagonally, same as the corner cutting
+	 *        grid links, so any two neighboring free cells can always see each other
+	 */
+	bool line_of_sight(int x0, int y0, int x1, int y1) const;
+
+	/** @return TRUE if any bit in [first, last] is set */
+	static bool any_set(const unsigned __int64* bits, int first, int last);
+};
+
+#endif // COLLISION_MASK_H
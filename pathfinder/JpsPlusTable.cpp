@@ -0,0 +1,200 @@
+#include "JpsPlusTable.h"
+#include "PfThreadPool.h"
+#include "utils/binary_reader.h"
+#include "utils/binary_writer.h"
+#include "utils/fnv.h"
+
+
+void JpsPlusTable::destroy()
+{
+	if (Dist)
+	{
+		free(Dist);
+		Dist = 0;
+	}
+	Width  = 0;
+	Height = 0;
+	GridHash = 0;
+}
+
+
+/**
+ * Computes the jump distances of a single direction, one line of cells at a time.
+ * Every line is walked backwards from the cell at the grid edge, so each cell
+ * only needs the already computed distance of the next cell in that direction.
+ */
+struct JpsLineBuilder
+{
+	const ushort* Planes;
+	short* Dist;
+	int Width, Height;
+
+	__forceinline bool free(int x, int y) const
+	{
+		return unsigned(x) < unsigned(Width) && unsigned(y) < unsigned(Height) 
+			&& Planes[y * Width + x] != 1;
+	}
+
+	// number of independent lines in the given direction
+	inline int num_lines(int dir) const
+	{
+		int dx = AstarGrid::NeighborX[dir], dy = AstarGrid::NeighborY[dir];
+		return (dx ? Height : 0) + (dy ? (dx ? Width - 1 : Width) : 0);
+	}
+
+	// TRUE if the free cell [x, y] is a jump point when entered in direction [dx, dy]
+	inline bool is_jump_point(int x, int y, int dx, int dy) const
+	{
+		if (dx && dy) // diagonal: forced neighbors or a straight jump point
+		{
+			if ((free(x - dx, y + dy) && !free(x - dx, y)) ||
+				(free(x + dx, y - dy) && !free(x, y - dy)))
+				return true;
+			const short* d = &Dist[(y * Width + x) << 3];
+			return d[JpsPlusTable::dir_index(dx, 0)] > 0 || d[JpsPlusTable::dir_index(0, dy)] > 0;
+		}
+		if (dx) // horizontal
+			return (free(x + dx, y + 1) && !free(x, y + 1)) ||
+			       (free(x + dx, y - 1) && !free(x, y - 1));
+		// vertical
+		return (free(x + 1, y + dy) && !free(x + 1, y)) ||
+		       (free(x - 1, y + dy) && !free(x - 1, y));
+	}
+
+	void build_line(int dir, int line)
+	{
+		int dx = AstarGrid::NeighborX[dir], dy = AstarGrid::NeighborY[dir];
+
+		// find the last cell of the line at the grid edge
+		int x, y;
+		if (dx && line < Height)
+		{
+			x = dx > 0 ? Width - 1 : 0;
+			y = line;
+		}
+		else
+		{
+			if (dx) line -= Height;
+			x = (dx < 0) ? line + 1 : line; // diagonals skip the column already covered above
+			y = dy > 0 ? Height - 1 : 0;
+		}
+
+		for (; unsigned(x) < unsigned(Width) && unsigned(y) < unsigned(Height); x -= dx, y -= dy)
+		{
+			int nx = x + dx, ny = y + dy;
+			short dist;
+			if (!free(nx, ny))
+				dist = 0;
+			else if (is_jump_point(nx, ny, dx, dy))
+				dist = 1;
+			else
+			{
+				short next = Dist[((ny * Width + nx) << 3) + dir];
+				dist = next > 0 ? next + 1 : next - 1;
+			}
+			Dist[((y * Width + x) << 3) + dir] = dist;
+		}
+	}
+
+	// builds all lines of the given directions in parallel
+	void build(PfThreadPool& workers, const int* dirs, int numDirs)
+	{
+		int total = 0;
+		for (int i = 0; i < numDirs; ++i)
+			total += num_lines(dirs[i]);
+
+		workers.parallel_for(total, [=](int /*worker*/, int line)
+		{
+			int i = 0;
+			for (int n; line >= (n = num_lines(dirs[i])); ++i)
+				line -= n;
+			build_line(dirs[i], line);
+		});
+	}
+};
+
+
+void JpsPlusTable::create(const AstarGrid& grid, PfThreadPool& workers)
+{
+	destroy();
+	Width    = grid.Width;
+	Height   = grid.Height;
+	GridHash = hash(grid);
+	Dist     = (short*)malloc(bytes());
+
+	JpsLineBuilder builder = { grid.Planes, Dist, Width, Height };
+
+	// diagonal jump points depend on the straight distances, so those go first
+	static const int straight[4] = { 0, 2, 4, 6 };
+	static const int diagonal[4] = { 1, 3, 5, 7 };
+	builder.build(workers, straight, 4);
+	builder.build(workers, diagonal, 4);
+}
+
+
+unsigned __int64 JpsPlusTable::hash(const AstarGrid& grid)
+{
+	unsigned __int64 seed = fnv_hash(grid.Width);
+	fnv_combine(seed, grid.Height);
+	for (int i = 0, count = grid.Width * grid.Height; i < count; ++i)
+	{
+		unsigned char walkable = grid.walkable(i);
+		fnv_combine(seed, walkable);
+	}
+	return seed;
+}
+
+bool JpsPlusTable::matches(const AstarGrid& grid) const
+{
+	return Dist && Width == grid.Width && Height == grid.Height && GridHash == hash(grid);
+}
+
+
+// file layout: [magic][version][width][height][gridhash][ width * height * 8 shorts ]
+bool JpsPlusTable::save(const char* filename) const
+{
+	if (!Dist)
+		return false;
+
+	const unsigned headerSize = sizeof(int) * 4 + sizeof(__int64);
+	binary_filewriter w;
+	if (!w.open(filename))
+		return false;
+	w.reserve(headerSize + unsigned(bytes()));
+	w.write_int(FileMagic);
+	w.write_int(FileVersion);
+	w.write_int(Width);
+	w.write_int(Height);
+	w.write_int64(GridHash);
+	w.write(Dist, unsigned(bytes()));
+	return w.flush();
+}
+
+bool JpsPlusTable::load(const char* filename, const AstarGrid& grid)
+{
+	binary_filereader r;
+	if (!r.open(filename)) // reads the whole file in one go
+		return false;
+
+	const unsigned headerSize = sizeof(int) * 4 + sizeof(__int64);
+	if (r.size() < headerSize ||
+		r.read_int() != FileMagic ||
+		r.read_int() != FileVersion)
+		return false;
+
+	int width  = r.read_int();
+	int height = r.read_int();
+	unsigned __int64 gridHash = r.read_int64();
+	size_t size = sizeof(short) * 8 * size_t(width) * height;
+	if (width != grid.Width || height != grid.Height || 
+		r.size() - headerSize < size || gridHash != hash(grid))
+		return false; // stale data for another map
+
+	destroy();
+	Width    = width;
+	Height   = height;
+	GridHash = gridHash;
+	Dist     = (short*)malloc(size);
+	r.read((void*)Dist, unsigned(size));
+	return true;
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef JPS_PLUS_TABLE_H
+#define JPS_PLUS_TABLE_H
+
+#include "AstarGrid.h"
+
+struct PfThreadPool;
+
+/**
+ * JPS+ jump distances of every cell in each of the 8 directions, in AstarGrid neighbor order:
+ *   N[0,+1] NE[+1,+1] E[+1,0] SE[+1,-1] S[0,-1] SW[-1,-1] W[-1,0] NW[-1,+1]
+ * A distance > 0 is the number of steps to the next jump point,
+ * a distance <= 0 is the negated number of free steps before hitting a wall.
+ * @note Distances are 16-bit, so the grid can be at most 32767 cells wide or high
+ */
+struct JpsPlusTable
+{
+	short* Dist;      // jump distances [cell * 8 + direction]
+	int Width, Height;
+	unsigned __int64 GridHash; // fingerprint of the walkable cells this table was built from
+
+	static const int FileMagic   = 0x2b53504a; // "JPS+"
+	static const int FileVersion = 1;
+
+	inline JpsPlusTable() : Dist(0), Width(0), Height(0), GridHash(0) {}
+	inline ~JpsPlusTable() { destroy(); }
+	JpsPlusTable(const JpsPlusTable& other)          = delete; // NOCOPY
+	JpsPlusTable& operator=(const JpsPlusTable& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Precomputes the jump distances of the whole grid.
+	 *        Every row (and every column or diagonal line) is an independent job for the workers
+	 */
+	void create(const AstarGrid& grid, PfThreadPool& workers);
+	void destroy();
+
+	/**
+	 * @brief Writes the table to a versioned binary file
+	 * @return TRUE if the whole file was written
+	 */
+	bool save(const char* filename) const;
+
+	/**
+	 * @brief Loads the table with a single file read
+	 * @return FALSE if the file is missing, has a different version or was built from another grid
+	 */
+	bool load(const char* filename, const AstarGrid& grid);
+
+	/** @return TRUE if this table was built from the current walkable cells of the grid */
+	bool matches(const AstarGrid& grid) const;
+
+	/** @return Fingerprint of the walkable cells of the grid */
+	static unsigned __int64 hash(const AstarGrid& grid);
+
+	/** @return Total number of bytes allocated by this table */
+	inline size_t bytes() const { return sizeof(short) * 8 * size_t(Width) * Height; }
+
+	/** @return Direction index [0..7] of a unit step [dx, dy] */
+	static inline int dir_index(int dx, int dy)
+	{
+		static const int lookup[9] = { 5, 4, 3, 6, -1, 2, 7, 0, 1 };
+		return lookup[(dy + 1) * 3 + dx + 1];
+	}
+
+	/** @return The 8 jump distances of a cell */
+	inline const short* get(int cell) const { return &Dist[cell << 3]; }
+};
+
+#endif // JPS_PLUS_TABLE_H
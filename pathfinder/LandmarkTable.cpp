@@ -0,0 +1,204 @@
+#include "LandmarkTable.h"
+#include "JpsPlusTable.h"
+#include "PfThreadPool.h"
+#include "utils/binary_reader.h"
+#include "utils/binary_writer.h"
+
+void LandmarkTable::destroy()
+{
+	if (Dist)
+	{
+		free(Dist);
+		Dist = 0;
+	}
+	if (Landmarks)
+	{
+		free(Landmarks);
+		Landmarks = 0;
+	}
+	NumLandmarks = 0;
+	Width  = 0;
+	Height = 0;
+	GridHash = 0;
+}
+
+
+void LandmarkTable::store(int landmark, const int* cost)
+{
+	const int n = NumLandmarks;
+	ushort* dist = Dist + landmark;
+	for (int i = 0, count = Width * Height; i < count; ++i, dist += n)
+	{
+		int c = cost[i];
+		*dist = c < Unknown ? ushort(c) : Unknown;
+	}
+}
+
+
+void LandmarkTable::create(const AstarGrid& grid, int numLandmarks)
+{
+	destroy();
+	const int count = grid.Width * grid.Height;
+
+	// an arbitrary cell of the largest plane seeds the selection
+	int largest = -1;
+	for (int plane = 2; plane < grid.PlaneSizes.size(); ++plane)
+		if (largest == -1 || grid.PlaneSizes[plane] > grid.PlaneSizes[largest])
+			largest = plane;
+	int seed = -1;
+	for (int i = 0; i < count && seed == -1; ++i)
+		if (grid.Planes[i] == largest)
+			seed = i;
+	if (seed == -1)
+		return; // nothing walkable
+
+	if (numLandmarks > MaxLandmarks) numLandmarks = MaxLandmarks;
+	if (numLandmarks < 1)            numLandmarks = 1;
+	Width        = grid.Width;
+	Height       = grid.Height;
+	GridHash     = JpsPlusTable::hash(grid);
+	NumLandmarks = numLandmarks;
+	Landmarks    = (int*)malloc(sizeof(int) * numLandmarks);
+	Dist         = (ushort*)malloc(sizeof(ushort) * numLandmarks * size_t(count));
+
+	// planes smaller than this are not worth a landmark of their own
+	const int minPlaneSize = grid.PlaneSizes[largest] / (numLandmarks * 4);
+
+	int* cost    = (int*)malloc(sizeof(int) * count);
+	int* nearest = (int*)malloc(sizeof(int) * count); // cost to the nearest landmark
+	PfVector<int> buckets[12];
+	grid.dial_sweep(seed, nearest, buckets); // the first landmark is the farthest cell from the seed
+
+	for (int k = 0; k < numLandmarks; ++k)
+	{
+		int farthest = -1, farthestCost = -1;
+		int unreached = -1, unreachedSize = minPlaneSize;
+		for (int i = 0; i < count; ++i)
+		{
+			int plane = grid.Planes[i];
+			if (plane == 1)
+				continue;
+			int c = nearest[i];
+			if (c != AstarGrid::Unreachable)
+			{
+				if (c > farthestCost) farthest = i, farthestCost = c;
+			}
+			else if (plane < grid.PlaneSizes.size() && grid.PlaneSizes[plane] > unreachedSize)
+			{
+				unreached = i, unreachedSize = grid.PlaneSizes[plane];
+			}
+		}
+		int landmark = unreached != -1 ? unreached : farthest;
+		if (landmark == -1)
+			landmark = seed;
+
+		Landmarks[k] = landmark;
+		grid.dial_sweep(landmark, cost, buckets);
+		store(k, cost);
+		if (k == 0)
+			memcpy(nearest, cost, sizeof(int) * count);
+		else for (int i = 0; i < count; ++i)
+			if (cost[i] < nearest[i]) nearest[i] = cost[i];
+	}
+	free(cost);
+	free(nearest);
+}
+
+
+void LandmarkTable::create(const AstarGrid& grid, PfThreadPool& workers, const int* landmarks, int numLandmarks)
+{
+	destroy();
+	if (numLandmarks > MaxLandmarks) numLandmarks = MaxLandmarks;
+	if (numLandmarks < 1)
+		return;
+	const int count = grid.Width * grid.Height;
+	Width        = grid.Width;
+	Height       = grid.Height;
+	GridHash     = JpsPlusTable::hash(grid);
+	NumLandmarks = numLandmarks;
+	Landmarks    = (int*)malloc(sizeof(int) * numLandmarks);
+	Dist         = (ushort*)malloc(sizeof(ushort) * numLandmarks * size_t(count));
+	memcpy(Landmarks, landmarks, sizeof(int) * numLandmarks);
+
+	// every worker reuses its own sweep buffers
+	const int numWorkers = workers.size();
+	int** costs = new int*[numWorkers];
+	PfVector<int>* buckets = new PfVector<int>[numWorkers * 12];
+	for (int i = 0; i < numWorkers; ++i)
+		costs[i] = (int*)malloc(sizeof(int) * count);
+
+	workers.parallel_for(numLandmarks, [&](int worker, int k)
+	{
+		grid.dial_sweep(Landmarks[k], costs[worker], &buckets[worker * 12]);
+		store(k, costs[worker]);
+	});
+
+	for (int i = 0; i < numWorkers; ++i)
+		free(costs[i]);
+	delete[] costs;
+	delete[] buckets;
+}
+
+
+bool LandmarkTable::matches(const AstarGrid& grid) const
+{
+	return Dist && Width == grid.Width && Height == grid.Height && GridHash == JpsPlusTable::hash(grid);
+}
+
+
+// file layout: [magic][version][width][height][numlandmarks][gridhash][ numlandmarks ints ][ width * height * numlandmarks ushorts ]
+bool LandmarkTable::save(const char* filename) const
+{
+	if (!Dist)
+		return false;
+
+	const unsigned headerSize = sizeof(int) * 5 + sizeof(__int64);
+	const unsigned distSize   = unsigned(sizeof(ushort) * NumLandmarks * size_t(Width) * Height);
+	binary_filewriter w;
+	if (!w.open(filename))
+		return false;
+	w.reserve(headerSize + unsigned(bytes()));
+	w.write_int(FileMagic);
+	w.write_int(FileVersion);
+	w.write_int(Width);
+	w.write_int(Height);
+	w.write_int(NumLandmarks);
+	w.write_int64(GridHash);
+	w.write(Landmarks, unsigned(sizeof(int) * NumLandmarks));
+	w.write(Dist, distSize);
+	return w.flush();
+}
+
+bool LandmarkTable::load(const char* filename, const AstarGrid& grid)
+{
+	binary_filereader r;
+	if (!r.open(filename)) // reads the whole file in one go
+		return false;
+
+	const unsigned headerSize = sizeof(int) * 5 + sizeof(__int64);
+	if (r.size() < headerSize ||
+		r.read_int() != FileMagic ||
+		r.read_int() != FileVersion)
+		return false;
+
+	int width  = r.read_int();
+	int height = r.read_int();
+	int numLandmarks = r.read_int();
+	unsigned __int64 gridHash = r.read_int64();
+	size_t distSize = sizeof(ushort) * numLandmarks * size_t(width) * height;
+	size_t size     = sizeof(int) * numLandmarks + distSize;
+	if (width != grid.Width || height != grid.Height || numLandmarks < 1 || numLandmarks > MaxLandmarks ||
+		r.size() - headerSize < size || gridHash != JpsPlusTable::hash(grid))
+		return false; // stale data for another map
+
+	destroy();
+	Width        = width;
+	Height       = height;
+	NumLandmarks = numLandmarks;
+	GridHash     = gridHash;
+	Landmarks    = (int*)malloc(sizeof(int) * numLandmarks);
+	Dist         = (ushort*)malloc(distSize);
+	r.read((void*)Landmarks, unsigned(sizeof(int) * numLandmarks));
+	r.read((void*)Dist, unsigned(distSize));
+	return true;
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef LANDMARK_TABLE_H
+#define LANDMARK_TABLE_H
+
+#include "AstarGrid.h"
+
+struct PfThreadPool;
+
+/**
+ * Exact path costs from K landmark cells to every cell of the grid, for the ALT
+ * (A*, Landmarks, Triangle inequality) heuristic. For any landmark L:
+ *   cost(a, b) >= |cost(L, b) - cost(L, a)|
+ * The costs of a cell are stored next to each other, so a heuristic lookup touches a single cache line.
+ * @note Costs are 16-bit. Cells that are unreachable from a landmark, or farther than 65534,
+ *       are stored as Unknown and that landmark is skipped for them
+ */
+struct LandmarkTable
+{
+	ushort* Dist;      // landmark costs [cell * NumLandmarks + landmark]
+	int* Landmarks;    // cell index of every landmark
+	int NumLandmarks;
+	int Width, Height;
+	unsigned __int64 GridHash; // fingerprint of the walkable cells this table was built from
+
+	static const ushort Unknown   = 0xffff;
+	static const int MaxLandmarks = 32;
+	static const int FileMagic    = 0x20544c41; // "ALT "
+	static const int FileVersion  = 1;
+
+	inline LandmarkTable() : Dist(0), Landmarks(0), NumLandmarks(0), Width(0), Height(0), GridHash(0) {}
+	inline ~LandmarkTable() { destroy(); }
+	LandmarkTable(const LandmarkTable& other)          = delete; // NOCOPY
+	LandmarkTable& operator=(const LandmarkTable& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Selects the landmarks with farthest-point selection: every new landmark is the cell
+	 *        with the highest cost to its nearest landmark. Large planes that no landmark can reach
+	 *        get a landmark first. Every selection step depends on the previous sweep, so this
+	 *        runs on the calling thread, but the selection sweeps are also the final landmark costs
+	 * @param numLandmarks Number of landmarks to select, at most MaxLandmarks
+	 */
+	void create(const AstarGrid& grid, int numLandmarks = 8);
+
+	/**
+	 * @brief Builds the table for already known landmark cells, one landmark sweep per worker
+	 */
+	void create(const AstarGrid& grid, PfThreadPool& workers, const int* landmarks, int numLandmarks);
+	void destroy();
+
+	/**
+	 * @brief Writes the table to a versioned binary file
+	 * @return TRUE if the whole file was written
+	 */
+	bool save(const char* filename) const;
+
+	/**
+	 * @brief Loads the table with a single file read
+	 * @return FALSE if the file is missing, has a different version or was built from another grid
+	 */
+	bool load(const char* filename, const AstarGrid& grid);
+
+	/** @return TRUE if this table was built from the current walkable cells of the grid */
+	bool matches(const AstarGrid& grid) const;
+
+	/** @return Total number of bytes allocated by this table */
+	inline size_t bytes() const
+	{
+		return sizeof(ushort) * NumLandmarks * size_t(Width) * Height + sizeof(int) * NumLandmarks;
+	}
+
+	/** @return The landmark costs of a cell */
+	inline const ushort* get(int cell) const { return &Dist[cell * NumLandmarks]; }
+
+	/** @return Highest triangle inequality lower bound of the cost between two cells, 0 if none is known */
+	inline int lower_bound(const ushort* a, const ushort* b) const
+	{
+		int best = 0;
+		for (int i = 0; i < NumLandmarks; ++i)
+		{
+			int da = a[i], db = b[i];
+			if (da == Unknown || db == Unknown)
+				continue;
+			int d = da > db ? da - db : db - da;
+			if (d > best) best = d;
+		}
+		return best;
+	}
+
+	// writes the costs from a single sweep into the interleaved table
+	void store(int landmark, const int* cost);
+};
+
+#endif // LANDMARK_TABLE_H
@@ -1,136 +1,414 @@
-#include "PathfinderAstar.h"
+#include "AstarPolicies.h"
 
 
-	void PathfinderAstar::Create(float cellSize, int width, int height, const byte* initData)
+	void PathfinderAstar::Create(float cellSize, int width, int height, const byte* initData, AstarGridMode mode,
+	                             const byte* costData)
 	{
 		CellSize = cellSize;
 		CellHalfSize = cellSize * 0.5f;
-		OpenID = 0;
-		Grid.create(width, height, initData);
-		OpenList.reserve((width + height) * 4);
+		Start = End = -1;
+		if (Workers.size() == 1 && width * height >= AstarGrid::MinParallelCells)
+			Workers.create(); // large maps are labeled and linked on all cores
+		Grid.create(width, height, initData, mode, costData, &Workers);
+		Context.create(Grid);
+		ReverseContext.create(Grid);
+		JumpTable.destroy(); // built for the previous grid
+		Landmarks.destroy();
+		LosMask.create(Grid);
+		for (int i = 0; i < NumWorkerContexts; ++i)
+			WorkerContexts[i].create(Grid);
 	}
 	void PathfinderAstar::Destroy()
 	{
+		Workers.destroy();
+		if (WorkerContexts)
+		{
+			delete[] WorkerContexts;
+			WorkerContexts = NULL;
+			NumWorkerContexts = 0;
+		}
+		Context.destroy();
+		ReverseContext.destroy();
+		JumpTable.destroy();
+		Landmarks.destroy();
+		LosMask.destroy();
 		Grid.destroy();
+		Start = End = -1;
+	}
+
+
+	template<class OpenListType> 
+	bool PathfinderAstar::Process(SearchContextT<OpenListType>& ctx, int start, int end,
+	                              PfVector<Vector2>& outPath, PfVector<Vector2>* explored, int agentSize) const
+	{
+		// the trace is a template policy, so the search without one doesn't test it on every link
+		return explored
+			? ProcessPolicy<ManhattanHeuristic, Connect8>(ctx, start, end, outPath, ExploredTrace(explored), agentSize)
+			: ProcessPolicy<ManhattanHeuristic, Connect8>(ctx, start, end, outPath, NoTrace(), agentSize);
 	}
 
+	template<class OpenListType> 
+	bool PathfinderAstar::ProcessALT(SearchContextT<OpenListType>& ctx, int start, int end,
+	                                 PfVector<Vector2>& outPath, PfVector<Vector2>* explored, int agentSize) const
+	{
+		// without landmarks, fall back to the octile estimate: it's the best bound that still keeps the paths optimal
+		if (!Landmarks.Dist || Landmarks.Width != Grid.Width || Landmarks.Height != Grid.Height)
+			return explored
+				? ProcessPolicy<OctileHeuristic, Connect8>(ctx, start, end, outPath, ExploredTrace(explored), agentSize)
+				: ProcessPolicy<OctileHeuristic, Connect8>(ctx, start, end, outPath, NoTrace(), agentSize);
+
+		// landmark costs of one-cell agents are still lower bounds for larger agents
+		return explored
+			? ProcessPolicy<LandmarkHeuristic, Connect8>(ctx, start, end, outPath, ExploredTrace(explored), agentSize)
+			: ProcessPolicy<LandmarkHeuristic, Connect8>(ctx, start, end, outPath, NoTrace(), agentSize);
+	}
+
+	template bool PathfinderAstar::Process(SearchContextT<node_heap>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::Process(SearchContextT<node_vect>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::Process(SearchContextT<node_iheap>&,   int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::Process(SearchContextT<node_buckets>&, int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::ProcessALT(SearchContextT<node_heap>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::ProcessALT(SearchContextT<node_vect>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::ProcessALT(SearchContextT<node_iheap>&,   int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+	template bool PathfinderAstar::ProcessALT(SearchContextT<node_buckets>&, int, int, PfVector<Vector2>&, PfVector<Vector2>*, int) const;
+
+
+
 
 	/**
-	 * @warning This function is heavily optimized using profile guided optimization hints
-	 *          and cache stall info. If you plan to optimize/change this function, please 
-	 *          use a profiler to measure changes
+	 * One direction of a bidirectional search, heading from its origin to the other front's origin
 	 */
-	bool PathfinderAstar::Process(PfVector<Vector2>& outPath, PfVector<Vector2>* explored)
+	template<class Cost, class OpenListType> struct BidirectionalFront
 	{
-		NumOpened   = 0;
-		NumReopened = 0;
-		AstarNode* head = Start;
-		AstarNode* end  = End;
+		SearchContextT<OpenListType>& Ctx;
+		AstarState* States;
+		AstarState* Top;   // lowest FScore node, taken out of the open list. Its GScore is final
+		uint OpenID;
+		uint ClosedID;
+		int  GoalX, GoalY; // cell this front is heading to
+		int  NumOpened, NumReopened, NumExpanded;
+		Cost cost;
 
-		if (head->Plane != end->Plane || head->Plane == 1 || end->Plane == 1)
-			return false; // no possible path between these two, or collision planes(1)
+		BidirectionalFront(SearchContextT<OpenListType>& ctx, const AstarGrid& grid, int origin, int goal)
+			: Ctx(ctx), States(ctx.States), Top(NULL), OpenID(ctx.OpenID), ClosedID(ctx.OpenID | AstarState::ClosedBit),
+			  GoalX(grid.x_of(goal)), GoalY(grid.y_of(goal)), NumOpened(0), NumReopened(0), NumExpanded(0), cost(grid)
+		{
+			AstarState* s = &States[origin];
+			s->GScore = 0;
+			s->FScore = heuristic(grid.x_of(origin), grid.y_of(origin));
+			s->OpenID = OpenID;
+			s->Prev   = -1;
+			Top = s;
+		}
+
+		__forceinline int heuristic(int x, int y) const
+		{
+			return cost.scale(octile(GoalX - x, GoalY - y));
+		}
+
+		// @return GScore of the cell if this front has reached it, -1 otherwise
+		__forceinline int reached(int cell) const
+		{
+			const AstarState& s = States[cell];
+			return (s.OpenID & ~AstarState::ClosedBit) == OpenID ? s.GScore : -1;
+		}
+
+		// moves the next lowest FScore node out of the open list. @return FALSE if it's empty
+		__forceinline bool next()
+		{
+			Top = Ctx.Open.empty() ? NULL : Ctx.Open.pop();
+			return Top != NULL;
+		}
+	};
+
+	/**
+	 * Bidirectional A*: both fronts take turns, always expanding the one with the smaller open list,
+	 * so a front trapped in dead ends stops growing while the other one keeps going.
+	 * Every time a front reaches a cell the other front has already reached, the path through
+	 * that cell becomes a candidate, and nodes whose FScore can't beat it are no longer opened.
+	 * The search stops when the lowest FScore of either front is not better than the best candidate,
+	 * since with a consistent heuristic no cheaper path can remain.
+	 * @return Cell where the fronts met on the shortest path, -1 if there is no path
+	 */
+	template<class Neighbors, class Cost, class OpenListType> 
+	static int BidirectionalSearch(const PathfinderAstar& pf, SearchContextT<OpenListType>& fwdCtx,
+	                               SearchContextT<OpenListType>& bwdCtx, int start, int end, 
+	                               PfVector<Vector2>* explored)
+	{
+		typedef BidirectionalFront<Cost, OpenListType> Front;
+		const ushort* planes = pf.Grid.Planes;
+		const Neighbors neighbors(pf.Grid);
+		Front fwd(fwdCtx, pf.Grid, start, end);
+		Front bwd(bwdCtx, pf.Grid, end, start);
+		int maxDepth = fwdCtx.MaxDepth;
+		int bestCost = 0x3fffffff;
+		int meet     = -1;
 
-		head->Prev = NULL;
-		int openID = ++OpenID; // with 1000 * 60 pathfinds per second, this will overflow in: ~8.17 years
-		int goalX  = end->X;
-		int goalY  = end->Y;
+		Front* self  = NULL;
+		Front* other = NULL;
+		AstarState* states = NULL;
+		int head = -1, headGScore = 0, prev = -1;
 
-		while (head != end)
+		auto open = [&](int index, int x, int y, int gain)
 		{
-			AstarNode* prev  = head->Prev;
-			AstarLink* link  = head->Links;
-			AstarLink* elink = link + head->NumLinks;
-			int headGScore   = head->GScore;
+			if (planes[index] == 1 || index == prev)
+				return; // collision plane or circular reference
+
+			AstarState* s = &states[index];
+			const uint sid = s->OpenID;
+			if (sid == self->ClosedID || s == self->Top)
+				return; // the heuristic is consistent, so closed nodes and the top node are final
+
+			int gscore = headGScore + gain;
+			if (gscore + self->heuristic(x, y) >= bestCost)
+				return; // every path through this node is at least as long as the best candidate
+			if (sid == self->OpenID)
+			{
+				if (gscore >= s->GScore)
+					return;
+				s->FScore += gscore - s->GScore; // HScore stays the same
+				s->GScore  = gscore;
+				s->Prev    = head;
+				++self->NumOpened;
+				++self->NumReopened;
+				self->Ctx.Open.repos(s);
+			}
+			else
+			{
+				s->GScore = gscore;
+				s->FScore = gscore + self->heuristic(x, y);
+				s->Prev   = head;
+				s->OpenID = self->OpenID;
+				++self->NumOpened;
+				self->Ctx.Open.insert(s);
+			}
+
+			int otherGScore = other->reached(index);
+			if (otherGScore != -1 && gscore + otherGScore < bestCost)
+			{
+				bestCost = gscore + otherGScore;
+				meet     = index;
+			}
+
+			int size = fwdCtx.Open.size() + bwdCtx.Open.size();
+			if (size > maxDepth) maxDepth = size;
 
-			for (; link != elink; ++link)
+			if (explored)
 			{
-				AstarNode* n = link->node;
-				if (n == prev || n->Plane == 1)
-					continue; // avoid circural references
-
-				if (openID == n->OpenID) // we have opened this Node before
-				{
-					if (n->Closed) 
-						continue; // don't touch it if it's CLOSED
-
-					int gscore = headGScore + link->gain; // new gain score
-					if (gscore >= n->GScore) 
-						continue; // if the new gain is worse, then don't touch it
-
-					n->FScore = n->HScore + gscore;
-					n->GScore = gscore;
-					n->Prev   = head;
-
-					//// @note reopened:
-					++NumOpened;
-					++NumReopened;
-					OpenList.repos(n); // reposition item
-				}
-				else
-				{
-					// calculate HScore
-					// (abs(distX) + abs(distY))*8
-					int HScore = goalX - n->X, diffY = goalY - n->Y;
-					if (HScore < 0) HScore = -HScore;
-					if (diffY  < 0) diffY = -diffY;
-					HScore += diffY;
-					HScore <<= 3;
-
-					int GScore = headGScore + link->gain;
-					n->HScore = HScore;
-					n->GScore = GScore;
-					n->FScore = HScore + GScore;
-					n->Closed = false;
-					n->Prev   = head;
-					n->OpenID = openID;
-
-					//// @note first open:
-					++NumOpened;
-					OpenList.insert(n);
-				}
-
-				int size = OpenList.size();
-				if (size > MaxDepth) MaxDepth = size;
-
-				if (explored)
-				{
-					explored->push_back(ToScreenCoordCentered(head));
-					explored->push_back(ToScreenCoordCentered(n));
-				}
+				explored->push_back(pf.ToScreenCoordCentered(head));
+				explored->push_back(pf.ToScreenCoordCentered(index));
 			}
+		};
+
+		// an exhausted front has already met the other one on every path that exists
+		while (fwd.Top && bwd.Top)
+		{
+			if (fwd.Top->FScore >= bestCost || bwd.Top->FScore >= bestCost)
+				break; // meet-in-the-middle: nothing left in that front can beat the best path
+
+			if (fwdCtx.Open.size() <= bwdCtx.Open.size())
+				self = &fwd, other = &bwd;
+			else
+				self = &bwd, other = &fwd;
+
+			AstarState* headState = self->Top;
+			headState->OpenID = self->ClosedID;
+			++self->NumExpanded;
+			states     = self->States;
+			head       = int(headState - states);
+			headGScore = headState->GScore;
+			prev       = headState->Prev;
+			neighbors.for_each(head, open);
+			self->next();
+		}
+
+		fwdCtx.NumOpened   = fwd.NumOpened   + bwd.NumOpened;
+		fwdCtx.NumReopened = fwd.NumReopened + bwd.NumReopened;
+		fwdCtx.NumExpanded = fwd.NumExpanded + bwd.NumExpanded;
+		fwdCtx.MaxDepth    = maxDepth;
+		bwdCtx.NumOpened   = bwd.NumOpened;
+		bwdCtx.NumReopened = bwd.NumReopened;
+		bwdCtx.NumExpanded = bwd.NumExpanded;
+		fwdCtx.Open.clear();
+		bwdCtx.Open.clear();
+		return meet;
+	}
+
+
+	template<class OpenListType> 
+	bool PathfinderAstar::ProcessBidirectional(SearchContextT<OpenListType>& ctx, SearchContextT<OpenListType>& reverseCtx,
+	                                           int start, int end, PfVector<Vector2>& outPath, PfVector<Vector2>* explored) const
+	{
+		ctx.begin_search();
+		reverseCtx.begin_search();
+		const ushort* planes = Grid.Planes;
+		if (planes[start] != planes[end] || planes[start] == 1)
+			return false; // no possible path between these two, or collision planes(1)
+		if (start == end)
+		{
+			outPath.push_back(ToScreenCoordCentered(end));
+			return true;
+		}
 
-			// after inserting into the sorted list we get the heuristically best node available
-			if (OpenList.empty())
-				break;
+		int meet;
+		if (Grid.Costs) // link gains are symmetric, so the backward front can use the same neighbors
+			meet = Grid.Mode == GRID_LINKED
+				? BidirectionalSearch<LinkedNeighbors<Connect8>, TerrainCost>(*this, ctx, reverseCtx, start, end, explored)
+				: BidirectionalSearch<ImplicitNeighbors<TerrainCost, Connect8>, TerrainCost>(*this, ctx, reverseCtx, start, end, explored);
+		else
+			meet = Grid.Mode == GRID_LINKED
+				? BidirectionalSearch<LinkedNeighbors<Connect8>, UniformCost>(*this, ctx, reverseCtx, start, end, explored)
+				: BidirectionalSearch<ImplicitNeighbors<UniformCost, Connect8>, UniformCost>(*this, ctx, reverseCtx, start, end, explored);
+		if (meet == -1)
+			return false;
 
-			head = OpenList.pop();
-			head->Closed = true;
+		// construct the out path [end .. meet .. start]
+		const AstarState* fwd = ctx.States;
+		const AstarState* bwd = reverseCtx.States;
+		int first = outPath.size();
+		for (int index = bwd[meet].Prev; index != -1; index = bwd[index].Prev)
+			outPath.push_back(ToScreenCoordCentered(index));
+		for (int i = first, j = outPath.size() - 1; i < j; ++i, --j)
+		{
+			Vector2 tmp = outPath[i];
+			outPath[i] = outPath[j];
+			outPath[j] = tmp;
 		}
+		for (int index = meet; index != -1; index = fwd[index].Prev)
+			outPath.push_back(ToScreenCoordCentered(index));
+		return true;
+	}
+
+	template bool PathfinderAstar::ProcessBidirectional(SearchContextT<node_heap>&,    SearchContextT<node_heap>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessBidirectional(SearchContextT<node_vect>&,    SearchContextT<node_vect>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessBidirectional(SearchContextT<node_iheap>&,   SearchContextT<node_iheap>&,   int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessBidirectional(SearchContextT<node_buckets>&, SearchContextT<node_buckets>&, int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+
+
+
 
-		// construct the out path
-		head = end;
-		do {
-			Vector2 coord = ToScreenCoordCentered(head);
-			outPath.push_back(coord);
-		} while (head = head->Prev);
 
-		OpenList.clear(); // resets the pool
+
+	void PathfinderAstar::CreateWorkers(int numWorkers)
+	{
+		Workers.create(numWorkers);
+		if (WorkerContexts)
+			delete[] WorkerContexts;
+		NumWorkerContexts = Workers.size();
+		WorkerContexts = new SearchContext[NumWorkerContexts];
+		for (int i = 0; i < NumWorkerContexts; ++i)
+			WorkerContexts[i].create(Grid);
+	}
+
+	bool PathfinderAstar::SetBlocked(int x, int y, bool blocked)
+	{
+		return SetBlockedRect(x, y, 1, 1, blocked);
+	}
+	bool PathfinderAstar::SetBlockedRect(int x, int y, int w, int h, bool blocked)
+	{
+		if (!Grid.set_blocked(x, y, w, h, blocked))
+			return false;
+		JumpTable.destroy(); // ProcessJPSPlus() falls back to ProcessJPS() until it's recreated
+		Landmarks.destroy(); // landmark costs would no longer be lower bounds
+		LosMask.update(Grid, x, y, w, h);
+		if (Grid.Clearance)
+			Grid.update_clearance(x, y, w, h);
+		for (int i = 0; i < Listeners.size(); ++i)
+			Listeners[i]->OnGridChanged(x, y, w, h);
 		return true;
 	}
+	void PathfinderAstar::AddListener(AstarGridListener* listener)
+	{
+		Listeners.push_back(listener);
+	}
+	void PathfinderAstar::RemoveListener(AstarGridListener* listener)
+	{
+		Listeners.erase(listener);
+	}
+
+	void PathfinderAstar::CreateJumpTable()
+	{
+		if (!WorkerContexts)
+			CreateWorkers();
+		JumpTable.create(Grid, Workers);
+	}
+	bool PathfinderAstar::LoadJumpTable(const char* filename)
+	{
+		return JumpTable.load(filename, Grid);
+	}
+	bool PathfinderAstar::SaveJumpTable(const char* filename) const
+	{
+		return JumpTable.save(filename);
+	}
+
+	void PathfinderAstar::CreateLandmarks(int numLandmarks)
+	{
+		Landmarks.create(Grid, numLandmarks);
+	}
+	void PathfinderAstar::CreateLandmarks(const int* cells, int numLandmarks)
+	{
+		if (!WorkerContexts)
+			CreateWorkers();
+		Landmarks.create(Grid, Workers, cells, numLandmarks);
+	}
+	void PathfinderAstar::CreateClearance()
+	{
+		Grid.create_clearance();
+	}
+	bool PathfinderAstar::LoadLandmarks(const char* filename)
+	{
+		return Landmarks.load(filename, Grid);
+	}
+	bool PathfinderAstar::SaveLandmarks(const char* filename) const
+	{
+		return Landmarks.save(filename);
+	}
+
+	void PathfinderAstar::ProcessBatch(const PathRequest* reqs, int count, PathResult* out)
+	{
+		if (!WorkerContexts)
+			CreateWorkers();
+
+		Workers.parallel_for(count, [=](int worker, int i)
+		{
+			const PathRequest& req = reqs[i];
+			PathResult& result = out[i];
+			result.Path.clear();
 
+			SearchContext& ctx = WorkerContexts[worker];
+			int start = Grid.index(req.Start.x, req.Start.y);
+			int end   = Grid.index(req.End.x,   req.End.y);
+			if (start == -1 || end == -1)
+			{
+				result.Status      = PATH_INVALID;
+				result.NumOpened   = 0;
+				result.NumReopened = 0;
+				result.MaxDepth    = 0;
+				return;
+			}
 
+			ctx.MaxDepth  = 0; // report per-query depth
+			bool found    = Process(ctx, start, end, result.Path, NULL);
+			result.Status = found ? PATH_FOUND : PATH_UNREACHABLE;
+			if (found && req.Post != PATH_POST_NONE)
+				PostProcess(result.Path, req.Post);
+			result.NumOpened   = ctx.NumOpened;
+			result.NumReopened = ctx.NumReopened;
+			result.MaxDepth    = ctx.MaxDepth;
+		});
+	}
 
 
 
 
 	
-	Vector2 PathfinderAstar::ToScreenCoord(const AstarNode* node) const
+	Vector2 PathfinderAstar::ToScreenCoord(int cell) const
 	{
-		return Vector2(node->X * CellSize, node->Y * CellSize);
+		return Vector2(Grid.x_of(cell) * CellSize, Grid.y_of(cell) * CellSize);
 	}
-	Vector2 PathfinderAstar::ToScreenCoordCentered(const AstarNode* node) const
+	Vector2 PathfinderAstar::ToScreenCoordCentered(int cell) const
 	{
-		return Vector2(node->X * CellSize + CellHalfSize, node->Y * CellSize + CellHalfSize);
+		return Vector2(Grid.x_of(cell) * CellSize + CellHalfSize, Grid.y_of(cell) * CellSize + CellHalfSize);
 	}
 	Vector2i PathfinderAstar::ToVirtualCoord(const Vector2& pos) const
 	{
@@ -158,11 +436,9 @@
 	}
 	bool PathfinderAstar::SetStart(int x, int y)
 	{
-		AstarNode* n = Grid.get(x, y);
-		if (n && n != Start && n != End) { // not null && not same && not same as end
+		int n = Grid.index(x, y);
+		if (n != -1 && n != Start && n != End) { // valid && not same && not same as end
 			Start = n;
-			n->FScore = 0;
-			n->GScore = 0;
 			return true;
 		}
 		return false;
@@ -175,11 +451,9 @@
 	}
 	bool PathfinderAstar::SetEnd(int x, int y)
 	{
-		AstarNode* n = Grid.get(x, y);
-		if(n && n != End && n != Start) { // not null && not same && not same as start
+		int n = Grid.index(x, y);
+		if(n != -1 && n != End && n != Start) { // valid && not same && not same as start
 			End = n;
-			n->FScore = 0;
-			n->GScore = 0;
 			return true;
 		}
 		return false;
@@ -11,40 +11,180 @@ using std::forward_list;
 #include <deque>
 using std::deque;
 #include <xmmintrin.h>
-#include "GLDraw.h"
 
-#include "AstarGrid.h"
+#include "AstarSearchContext.h"
+#include "JpsPlusTable.h"
+#include "LandmarkTable.h"
+#include "CollisionMask.h"
+#include "PfThreadPool.h"
 
 extern Vector2 gScreen; // global screen size
 
+struct Connect8; // default search policies, see AstarPolicies.h
+struct NoTrace;
+struct SpareTime;
+struct PathfinderAstar;
+
+enum PathStatus
+{
+	PATH_FOUND,       // path was found
+	PATH_UNREACHABLE, // start and end are on different planes or in a collision plane
+	PATH_INVALID,     // start or end is outside of the grid
+	PATH_TIMEOUT,     // the deadline passed before the search finished, see PathService
+};
+
+// optional reduction of the per-cell paths from Process()
+enum PathPostProcess
+{
+	PATH_POST_NONE,       // a waypoint for every traversed cell
+	PATH_POST_COLLINEAR,  // collinear runs collapsed, only the cells where the direction changes remain
+	PATH_POST_STRINGPULL, // only the corners remain, every segment has line of sight
+};
+
+// compact waypoint in virtual (grid) coordinates, 4 bytes instead of the 8 of a Vector2
+struct PathPoint16
+{
+	ushort x, y;
+};
+
+// a single path query for PathfinderAstar::ProcessBatch()
+struct PathRequest
+{
+	Vector2i Start;  // virtual start coordinate
+	Vector2i End;    // virtual end coordinate
+	PathPostProcess Post; // applied to the resulting path, PATH_POST_NONE by default
+
+	inline PathRequest() : Post(PATH_POST_NONE) {}
+};
+
+// result of a single PathRequest. The Path buffer is reused between batches
+struct PathResult
+{
+	PfVector<Vector2> Path; // resulting path in screen coordinates [end .. start]
+	PathStatus Status;
+	int NumOpened;      // number of grids opened by the pathfinder
+	int NumReopened;    // number of grids reopened by the pathfinder
+	int MaxDepth;       // max openlist depth of this query
+};
+
+// a cell within the cost bound of PathfinderAstar::ReachableWithin()
+struct ReachableCell
+{
+	int Cell; // cell index
+	int Cost; // cost of the cheapest path from the start, in the units of the path costs
+};
+
+enum SearchStatus
+{
+	SEARCH_IN_PROGRESS, // call Step() again
+	SEARCH_FOUND,       // the path is ready
+	SEARCH_FAILED,      // there is no path, or the search was canceled
+};
+
+/**
+ * Handle of a resumable search started with PathfinderAstar::BeginSearch().
+ * The node states of the search live in its own Context, so any number of searches
+ * can be in progress at the same time. Handles can be reused for any number of searches.
+ * @note Restart the search if the grid changes while it's in progress
+ */
+struct PathSearch
+{
+	SearchContext Context;  // node states of this search, allocated by the first BeginSearch()
+	PfVector<Vector2> Path; // resulting path [end .. start], once Status is SEARCH_FOUND
+	PfVector<Vector2>* Explored; // optional explored line pairs [A,B], NULL by default
+	SearchStatus Status;
+	int Start, End;
+	int Head;      // next cell to expand
+	int NumSteps;  // number of Step() calls of this search
+	int AgentSize; // footprint of the agent in cells, see PathfinderAstar::Process()
+
+	inline PathSearch() : Explored(0), Status(SEARCH_FAILED), Start(-1), End(-1), Head(-1), NumSteps(0), AgentSize(1) {}
+};
+
+/**
+ * Round-robin queue of resumable searches. Every search advances by a slice of expansions
+ * at a time, so a long search can't starve the others. Finished and canceled searches 
+ * leave the queue, the caller polls PathSearch::Status
+ */
+struct PathSearchQueue
+{
+	PfVector<PathSearch*> Searches;
+	int Next;            // next search to step
+	int SliceExpansions; // expansions per Step() call
+
+	inline PathSearchQueue() : Next(0), SliceExpansions(256) {}
+
+	// the search must have been started with BeginSearch() and stay alive until it leaves the queue
+	void add(PathSearch* search);
+	void remove(PathSearch* search);
+	inline bool empty() const { return Searches.empty(); }
+
+	/**
+	 * @brief Steps the queued searches until maxExpansions nodes were expanded or the queue is empty
+	 * @return TRUE if any search was advanced
+	 */
+	bool advance(const PathfinderAstar& pf, int maxExpansions);
+
+	/**
+	 * @brief Steps the queued searches until the spare time runs out or the queue is empty.
+	 *        Meant for the vsync spare time hook
+	 * @param bufferTime Stops this many seconds before the spare time runs out
+	 * @return TRUE if any search was advanced
+	 */
+	bool advance(const PathfinderAstar& pf, const SpareTime& spareTime, float bufferTime = 0.0005f);
+};
+
+/**
+ * Gets notified after cells of a PathfinderAstar grid were blocked or unblocked
+ */
+struct AstarGridListener
+{
+	virtual ~AstarGridListener() {}
+	virtual void OnGridChanged(int x, int y, int w, int h) = 0;
+};
+
 struct PathfinderAstar
 {
 	AstarGrid  Grid;
-	AstarNode* Start;	// start of the path
-	AstarNode* End;		// end of the path (destination)
+	int Start;			// cell index of the start of the path, -1 if not set
+	int End;			// cell index of the end of the path (destination), -1 if not set
 	float CellSize;
 	float CellHalfSize; // CellSize / 2. Going to use this often, so better cache it
-	int NumOpened;		// number of grids opened by the pathfinder
-	int NumReopened;	// number of grids reopened by the pathfinder
-	int MaxDepth;       // max openlist depth
-	uint OpenID;        // unique ID to use when opening new grids
 
-	PfOpenList OpenList;
+	SearchContext Context; // search state used by the single-threaded Process()
+	SearchContext ReverseContext; // backward search state used by the single-threaded ProcessBidirectional()
+	JpsPlusTable  JumpTable; // precomputed jump distances for ProcessJPSPlus()
+	LandmarkTable Landmarks; // precomputed landmark costs for ProcessALT()
+	CollisionMask LosMask;   // line-of-sight mask for ProcessTheta(), kept up to date by SetBlocked()
+
+	PfThreadPool   Workers;        // worker threads for ProcessBatch()
+	SearchContext* WorkerContexts; // one search context per worker, reused between batches
+	int NumWorkerContexts;
+
+	PfVector<AstarGridListener*> Listeners; // notified by SetBlocked()
 
 	inline PathfinderAstar() 
-		: Start(0), End(0), CellSize(1.0f), CellHalfSize(0.5f), 
-		  NumOpened(0), NumReopened(0), MaxDepth(0)
+		: Start(-1), End(-1), CellSize(1.0f), CellHalfSize(0.5f), WorkerContexts(0), NumWorkerContexts(0)
 	{
 	}
-	void Create(float cellSize, int width, int height, const byte* initData);
+	inline ~PathfinderAstar() { Destroy(); }
+	/**
+	 * @brief Creates the pathfinding grid from 2D 1-channel bitmap data
+	 * @param mode GRID_COMPACT stores only 2 bytes per cell, at the cost of computing neighbors
+	 * @param costData Optional terrain cost of every cell, see AstarGrid::create()
+	 * @note  Grids of AstarGrid::MinParallelCells or more start the Workers, so the planes
+	 *        and links are built on all cores
+	 */
+	void Create(float cellSize, int width, int height, const byte* initData, AstarGridMode mode = GRID_LINKED,
+	            const byte* costData = NULL);
 	void Destroy();
 
 	
-	// converts a node's virtual lower-left position to screen position
-	Vector2 ToScreenCoord(const AstarNode* node) const;
+	// converts a cell's virtual lower-left position to screen position
+	Vector2 ToScreenCoord(int cell) const;
 
-	// converts a node's virtual center position to screen position
-	Vector2 ToScreenCoordCentered(const AstarNode* node) const;
+	// converts a cell's virtual center position to screen position
+	Vector2 ToScreenCoordCentered(int cell) const;
 
 	// converts a screen coordinate to virtual coordinates
 	// only works correctly for positions that match InWorld()
@@ -53,6 +193,23 @@ struct PathfinderAstar
 	bool InWorld(float x, float y) const;
 
 
+	/**
+	 * @brief Places or removes an obstacle. Links and plane ID-s are updated incrementally,
+	 *        so the unreachable target early-out stays valid without recreating the grid
+	 * @note  Invalidates the JumpTable and Landmarks and notifies all Listeners
+	 * @return TRUE if the cell changed
+	 */
+	bool SetBlocked(int x, int y, bool blocked);
+
+	/**
+	 * @brief Same as SetBlocked() for all cells in [x, y, x+w, y+h), like placing a building
+	 */
+	bool SetBlockedRect(int x, int y, int w, int h, bool blocked);
+
+	void AddListener(AstarGridListener* listener);
+	void RemoveListener(AstarGridListener* listener);
+
+
 	bool SetEnd(int x, int y);
 	bool SetStart(int x, int y);
 	bool SetEnd(const Vector2& worldXY);
@@ -63,8 +220,228 @@ struct PathfinderAstar
 	 * @note  Call SetStart() and SetEnd()
 	 * @param outPath Resulting 
 	 * @param explored List of explored paths in line pairs [A,B]; [B,C]; ...
+	 * @param agentSize Footprint of the agent in cells, see the search context overload
+	 */
+	inline bool Process(PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL, int agentSize = 1)
+	{
+		return Process(Context, Start, End, outPath, explored, agentSize);
+	}
+
+	/**
+	 * @brief Finds a path from start to end using the given search context.
+	 *        The grid is not modified, so this can be called from multiple threads
+	 *        concurrently, as long as every thread uses its own SearchContext.
+	 * @note  Instantiated for node_heap, node_vect, node_iheap and node_buckets
+	 * @param ctx Search context created for this Grid
+	 * @param start Cell index of the start
+	 * @param end Cell index of the end
+	 * @param agentSize Footprint of the agent in cells. Agents larger than one cell only
+	 *                  visit cells with enough Grid.Clearance, call CreateClearance() first
+	 */
+	template<class OpenListType> 
+	bool Process(SearchContextT<OpenListType>& ctx, int start, int end,
+	             PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL, int agentSize = 1) const;
+
+	/**
+	 * @brief Finds every cell reachable from start with a path cost of at most maxCost, like the
+	 *        movement range of a unit. Costs are in the units of the links: 8 per straight step and
+	 *        11 per diagonal step, multiplied by the terrain costs. The cells are appended in order of
+	 *        increasing cost, starting with the start itself. Links past maxCost are never opened.
+	 *        The grid is not modified, so this can run on any thread with its own SearchContext,
+	 *        and with a reused context and outCells it doesn't allocate
+	 * @note  Instantiated for node_heap, node_vect, node_iheap and node_buckets
+	 * @param agentSize Footprint of the agent in cells, same as Process()
+	 * @return Number of cells appended to outCells, 0 if the agent can't stand on the start
+	 */
+	template<class OpenListType>
+	int ReachableWithin(SearchContextT<OpenListType>& ctx, int start, int maxCost,
+	                    PfVector<ReachableCell>& outCells, int agentSize = 1) const;
+
+	/**
+	 * @brief ReachableWithin() from the current Start with the single-threaded Context
+	 */
+	inline int ReachableWithin(int maxCost, PfVector<ReachableCell>& outCells, int agentSize = 1)
+	{
+		return ReachableWithin(Context, Start, maxCost, outCells, agentSize);
+	}
+
+	/**
+	 * @brief Starts a resumable search with the same heuristic as Process(). 
+	 *        Nothing is expanded until Step() is called
+	 * @param search Search handle, its Context is created for this grid if needed
+	 * @param agentSize Footprint of the agent in cells, same as Process()
+	 * @return SEARCH_IN_PROGRESS, or SEARCH_FAILED if start and end are not connected
+	 */
+	SearchStatus BeginSearch(PathSearch& search, int start, int end, int agentSize = 1) const;
+
+	/**
+	 * @brief Advances a search by at most maxExpansions node expansions.
+	 *        Once it's found, search.Path holds the path [end .. start]
+	 * @return Status of the search
+	 */
+	SearchStatus Step(PathSearch& search, int maxExpansions) const;
+
+	/**
+	 * @brief Stops a search in progress. Its status becomes SEARCH_FAILED
+	 */
+	void Cancel(PathSearch& search) const;
+
+	/**
+	 * @brief Finds a path with compile-time search policies. Every combination is its own
+	 *        search loop, so a search without a trace never tests for one on every link.
+	 *        Process() is ProcessPolicy<ManhattanHeuristic, Connect8>()
+	 * @note  Defined in AstarPolicies.h, include it to call this with other policies
+	 * @param Heuristic ManhattanHeuristic, OctileHeuristic, EuclideanHeuristic or LandmarkHeuristic
+	 * @param Connectivity Connect8 or Connect4
+	 * @param trace NoTrace, or ExploredTrace to record the explored links
+	 * @param agentSize Footprint of the agent in cells, same as Process()
+	 */
+	template<template<class> class Heuristic, class Connectivity = Connect8, class Trace = NoTrace, class OpenListType>
+	bool ProcessPolicy(SearchContextT<OpenListType>& ctx, int start, int end,
+	                   PfVector<Vector2>& outPath, const Trace& trace = Trace(), int agentSize = 1) const;
+
+	/**
+	 * @brief Same as Process(), but with the ALT heuristic: the highest triangle inequality bound
+	 *        of the precomputed Landmarks, which sees around long walls that the manhattan estimate 
+	 *        can't. The heuristic never overestimates, so the paths are optimal.
+	 *        Falls back to the octile heuristic if there are no Landmarks, so the paths stay optimal
+	 * @note  Call CreateLandmarks() or LoadLandmarks() after Create(), and again after SetBlocked()
+	 * @note  Instantiated for node_heap, node_vect, node_iheap and node_buckets
+	 */
+	template<class OpenListType> 
+	bool ProcessALT(SearchContextT<OpenListType>& ctx, int start, int end,
+	                PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL, int agentSize = 1) const;
+
+	/**
+	 * @brief Processes the current pathfinding request with a bidirectional search
+	 * @note  Call SetStart() and SetEnd()
+	 */
+	inline bool ProcessBidirectional(PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL)
+	{
+		return ProcessBidirectional(Context, ReverseContext, Start, End, outPath, explored);
+	}
+
+	/**
+	 * @brief Searches from start and end at the same time until the two fronts meet.
+	 *        Uses the octile heuristic, so the resulting paths are optimal. Compare it against
+	 *        ProcessPolicy<OctileHeuristic>(), it's not faster on every map
+	 * @note  Instantiated for node_heap, node_vect, node_iheap and node_buckets
+	 * @param ctx Forward search context, receives the statistics of both directions
+	 * @param reverseCtx Backward search context, must be different from ctx
+	 * @param outPath Resulting path in screen coordinates [end .. start], same as Process()
+	 */
+	template<class OpenListType> 
+	bool ProcessBidirectional(SearchContextT<OpenListType>& ctx, SearchContextT<OpenListType>& reverseCtx,
+	                          int start, int end, PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL) const;
+
+	/**
+	 * @brief Finds an any-angle path with Lazy Theta*. Nodes are linked straight to the parent
+	 *        of their predecessor and the line of sight is verified only once, when a node is expanded.
+	 *        The paths are not guaranteed to be optimal, but are shorter than the grid paths
+	 *        of Process() and don't need any smoothing
+	 * @note  Instantiated for node_heap, node_vect, node_iheap and node_buckets
+	 * @param outPath Resulting waypoints in screen coordinates [end .. start]
+	 * @param explored Receives line pairs from every opened node to its assumed parent
+	 */
+	template<class OpenListType> 
+	bool ProcessTheta(SearchContextT<OpenListType>& ctx, int start, int end,
+	                  PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL) const;
+
+	/**
+	 * @brief Finds a path from start to end with Jump Point Search. Only valid for
+	 *        uniform-cost grids, where it gives the same path costs as Process()
+	 *        while opening far fewer nodes. Works in both GRID_LINKED and GRID_COMPACT modes
+	 * @note  Instantiated for node_heap, node_vect, node_iheap and node_buckets
+	 * @param explored Receives line pairs between expanded jump points
+	 */
+	template<class OpenListType> 
+	bool ProcessJPS(SearchContextT<OpenListType>& ctx, int start, int end,
+	                PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL) const;
+
+	/**
+	 * @brief Same as ProcessJPS(), but jumps are looked up from the precomputed JumpTable
+	 *        instead of scanning the grid. Falls back to ProcessJPS() if there is no JumpTable
+	 * @note  Call CreateJumpTable() or LoadJumpTable() after Create()
+	 */
+	template<class OpenListType> 
+	bool ProcessJPSPlus(SearchContextT<OpenListType>& ctx, int start, int end,
+	                    PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL) const;
+
+	/**
+	 * @brief Precomputes the JPS+ JumpTable of the current grid on all worker threads
+	 */
+	void CreateJumpTable();
+
+	/**
+	 * @brief Loads a JumpTable saved with SaveJumpTable()
+	 * @return FALSE if the file is missing, outdated or doesn't match the current grid
+	 */
+	bool LoadJumpTable(const char* filename);
+
+	/**
+	 * @brief Saves the JumpTable, so it can be shipped alongside the map
+	 */
+	bool SaveJumpTable(const char* filename) const;
+
+	/**
+	 * @brief Selects and precomputes the ALT Landmarks with farthest-point selection
+	 * @param numLandmarks Number of landmarks, at most LandmarkTable::MaxLandmarks
+	 */
+	void CreateLandmarks(int numLandmarks = 8);
+
+	/**
+	 * @brief Precomputes the ALT Landmarks for the given landmark cells on all worker threads
+	 */
+	void CreateLandmarks(const int* cells, int numLandmarks);
+
+	/**
+	 * @brief Loads Landmarks saved with SaveLandmarks()
+	 * @return FALSE if the file is missing, outdated or doesn't match the current grid
+	 */
+	bool LoadLandmarks(const char* filename);
+
+	/**
+	 * @brief Saves the Landmarks, so they are computed once per map instead of at every startup
+	 */
+	bool SaveLandmarks(const char* filename) const;
+
+	/**
+	 * @brief Computes the Grid.Clearance for the searches of agents larger than one cell.
+	 *        SetBlocked() keeps it up to date incrementally.
+	 * @note  Only Process(), ProcessALT(), ProcessPolicy() and the sliced searches honor the agent size
+	 */
+	void CreateClearance();
+
+	/**
+	 * @brief Reduces a path [end .. start] of Process() in place. The first and the last waypoints
+	 *        are always kept. String pulling first collapses the collinear runs and then greedily
+	 *        skips every corner that the previous kept waypoint can see past
+	 * @note  Only for paths of this grid in ToScreenCoordCentered() coordinates
+	 */
+	void PostProcess(PfVector<Vector2>& path, PathPostProcess mode) const;
+
+	/**
+	 * @brief Converts a path in screen coordinates to virtual (grid) coordinates, in the same order
+	 */
+	void ToVirtualPath(const PfVector<Vector2>& path, PfVector<Vector2i>& outPath) const;
+	void ToVirtualPath(const PfVector<Vector2>& path, PfVector<PathPoint16>& outPath) const;
+
+	/**
+	 * @brief Starts the worker threads used by ProcessBatch()
+	 * @param numWorkers Total number of workers including the calling thread.
+	 *                   If <= 0, the number of hardware threads is used
+	 */
+	void CreateWorkers(int numWorkers = 0);
+
+	/**
+	 * @brief Processes a batch of path requests on all worker threads.
+	 *        Results are written in request order: out[i] is the result of reqs[i]
+	 * @note  Workers are created on first use if CreateWorkers() wasn't called
+	 * @param reqs Path requests to process
+	 * @param count Number of requests
+	 * @param out Array of at least [count] results. Existing path buffers are reused
 	 */
-	bool Process(PfVector<Vector2>& outPath, PfVector<Vector2>* explored = NULL);
+	void ProcessBatch(const PathRequest* reqs, int count, PathResult* out);
 };
 
 
@@ -0,0 +1,195 @@
+#include "PathfinderCache.h"
+
+
+	static __forceinline int sign(int v) { return (v > 0) - (v < 0); }
+
+	void PathCache::Create(PathfinderAstar* finder, size_t maxBytes)
+	{
+		Destroy();
+		Finder   = finder;
+		MaxBytes = maxBytes;
+		Finder->AddListener(this);
+	}
+
+	void PathCache::Destroy()
+	{
+		Clear();
+		Scratch.deallocate();
+		if (Finder)
+		{
+			Finder->RemoveListener(this);
+			Finder = NULL;
+		}
+	}
+
+	bool PathCache::Process(int start, int end, int agentClass, PfVector<Vector2>& outPath, int agentSize)
+	{
+		if (Find(start, end, agentClass, outPath))
+			return true;
+		if (start == -1 || end == -1)
+			return false;
+
+		int first = outPath.size(); // outPath may already contain other paths
+		if (!Finder->Process(Finder->Context, start, end, outPath, NULL, agentSize))
+			return false;
+
+		Scratch.clear();
+		for (int i = first; i < outPath.size(); ++i)
+			Scratch.push_back(outPath[i]);
+		Insert(start, end, agentClass, Scratch, agentSize);
+		return true;
+	}
+
+	bool PathCache::Find(int start, int end, int agentClass, PfVector<Vector2>& outPath)
+	{
+		PathCacheKey key = { start, end, agentClass };
+		auto found = Index.find(key);
+		if (found == Index.end())
+		{
+			++NumMisses;
+			return false;
+		}
+		++NumHits;
+
+		EntryList::iterator it = found->second;
+		Entries.splice(Entries.begin(), Entries, it); // most recently used
+
+		// expand the turning cells back into every cell of the path
+		const PfVector<PathPoint16>& points = it->Points;
+		const int width = Finder->Grid.Width;
+		int x = points[0].x, y = points[0].y;
+		outPath.push_back(Finder->ToScreenCoordCentered(y * width + x));
+		for (int i = 1; i < points.size(); ++i)
+		{
+			int px = points[i].x, py = points[i].y;
+			int dx = sign(px - x), dy = sign(py - y);
+			while (x != px || y != py)
+			{
+				x += dx, y += dy;
+				outPath.push_back(Finder->ToScreenCoordCentered(y * width + x));
+			}
+		}
+		return true;
+	}
+
+	void PathCache::Insert(int start, int end, int agentClass, const PfVector<Vector2>& path, int agentSize)
+	{
+		if (path.empty())
+			return;
+
+		PathCacheKey key = { start, end, agentClass };
+		auto found = Index.find(key);
+		if (found != Index.end())
+			erase(found->second);
+
+		if (&path != &Scratch)
+		{
+			Scratch.clear();
+			for (const Vector2& pos : path)
+				Scratch.push_back(pos);
+		}
+		Finder->PostProcess(Scratch, PATH_POST_COLLINEAR);
+
+		Entries.emplace_front();
+		PathCacheEntry& entry = Entries.front();
+		entry.Key = key;
+		entry.Radius = ushort(AstarGrid::clearance_for(agentSize) - 1);
+		entry.Points.reserve(Scratch.size());
+		Finder->ToVirtualPath(Scratch, entry.Points);
+
+		int minX = entry.Points[0].x, maxX = minX;
+		int minY = entry.Points[0].y, maxY = minY;
+		for (const PathPoint16& p : entry.Points) // segments are straight, so the turning cells span the whole path
+		{
+			if (p.x < minX) minX = p.x; else if (p.x > maxX) maxX = p.x;
+			if (p.y < minY) minY = p.y; else if (p.y > maxY) maxY = p.y;
+		}
+		entry.MinX = ushort(minX), entry.MaxX = ushort(maxX);
+		entry.MinY = ushort(minY), entry.MaxY = ushort(maxY);
+
+		size_t bytes = entry_bytes(entry);
+		if (bytes > MaxBytes) // would evict everything else and still not fit
+		{
+			Entries.pop_front();
+			return;
+		}
+		Index[key] = Entries.begin();
+		NumBytes += bytes;
+
+		while (NumBytes > MaxBytes)
+		{
+			erase(--Entries.end()); // least recently used
+			++NumEvictions;
+		}
+	}
+
+	void PathCache::Clear()
+	{
+		Entries.clear();
+		Index.clear();
+		NumBytes = 0;
+	}
+
+	void PathCache::ResetStats()
+	{
+		NumHits          = 0;
+		NumMisses        = 0;
+		NumEvictions     = 0;
+		NumInvalidations = 0;
+	}
+
+	void PathCache::OnGridChanged(int x, int y, int w, int h)
+	{
+		for (EntryList::iterator it = Entries.begin(); it != Entries.end(); )
+		{
+			EntryList::iterator entry = it++;
+			if (crosses(*entry, x, y, w, h))
+			{
+				erase(entry);
+				++NumInvalidations;
+			}
+		}
+	}
+
+	void PathCache::erase(EntryList::iterator it)
+	{
+		NumBytes -= entry_bytes(*it);
+		Index.erase(it->Key);
+		Entries.erase(it);
+	}
+
+	bool PathCache::crosses(const PathCacheEntry& entry, int x, int y, int w, int h) const
+	{
+		// grow the edit by the footprint of the agent, so the path cells can be tested directly
+		int x2 = x + w - 1 + entry.Radius, y2 = y + h - 1 + entry.Radius;
+		x -= entry.Radius, y -= entry.Radius;
+		if (x > entry.MaxX || x2 < entry.MinX || y > entry.MaxY || y2 < entry.MinY)
+			return false; // the edit is outside of the bounding box
+		if (InvalidateRegion)
+			return true;
+
+		const PfVector<PathPoint16>& points = entry.Points;
+		int cx = points[0].x, cy = points[0].y;
+		if (x <= cx && cx <= x2 && y <= cy && cy <= y2)
+			return true;
+		for (int i = 1; i < points.size(); ++i)
+		{
+			int px = points[i].x, py = points[i].y;
+			int dx = sign(px - cx), dy = sign(py - cy);
+			while (cx != px || cy != py)
+			{
+				cx += dx, cy += dy;
+				if (x <= cx && cx <= x2 && y <= cy && cy <= y2)
+					return true;
+			}
+		}
+		return false;
+	}
+
+	size_t PathCache::entry_bytes(const PathCacheEntry& entry)
+	{
+		// the entry in its list node, its hash map node and the point buffer
+		return sizeof(PathCacheEntry) + 2 * sizeof(void*)
+			+ sizeof(PathCacheKey) + 3 * sizeof(void*)
+			+ entry.Points.capacity() * sizeof(PathPoint16);
+	}
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PATHFINDER_CACHE_H
+#define PATHFINDER_CACHE_H
+
+#include "PathfinderAstar.h"
+#include <list>
+#include <unordered_map>
+
+// identifies a cached path: agents of different classes never share paths
+struct PathCacheKey
+{
+	int Start;      // start cell index
+	int End;        // end cell index
+	int AgentClass; // caller defined class of the agent, e.g. its size or movement type
+
+	inline bool operator==(const PathCacheKey& k) const
+	{
+		return Start == k.Start && End == k.End && AgentClass == k.AgentClass;
+	}
+};
+
+struct PathCacheKeyHash
+{
+	inline size_t operator()(const PathCacheKey& k) const
+	{
+		return (size_t(k.Start) * 0x9E3779B1u) ^ (size_t(k.End) * 0x85EBCA77u) ^ size_t(k.AgentClass);
+	}
+};
+
+// a cached path, compressed to the cells where its direction changes
+struct PathCacheEntry
+{
+	PathCacheKey Key;
+	ushort MinX, MinY, MaxX, MaxY;  // bounding box of the path cells
+	ushort Radius;                  // footprint radius of the agent, edits this close to the path affect it
+	PfVector<PathPoint16> Points;   // [end .. start], only the turning cells
+};
+
+/**
+ * LRU cache of Process() results for repeating queries, such as workers walking between
+ * the same resource and depot. Paths are stored as their turning cells (PATH_POST_COLLINEAR)
+ * and expanded back into the exact per-cell path on a hit.
+ * The total size of the entries is capped at MaxBytes, least recently used entries are evicted first.
+ * Listens to grid changes and drops the entries an edit could affect.
+ * @note Not thread safe, entries are added and evicted by Process()
+ */
+struct PathCache : public AstarGridListener
+{
+	typedef std::list<PathCacheEntry> EntryList;
+
+	PathfinderAstar* Finder;
+	EntryList Entries; // most recently used first
+	std::unordered_map<PathCacheKey, EntryList::iterator, PathCacheKeyHash> Index;
+	PfVector<Vector2> Scratch; // compression buffer
+	size_t MaxBytes;           // memory cap of all entries
+	size_t NumBytes;           // current memory use of all entries
+
+	/**
+	 * TRUE: an edit anywhere inside the bounding box of a path drops it, so a newly
+	 *       opened shortcut is picked up by the next query (default)
+	 * FALSE: only edits of the path cells themselves drop it; paths stay valid, but can
+	 *        be longer than a fresh search would find
+	 */
+	bool InvalidateRegion;
+
+	int NumHits;          // lookups answered from the cache
+	int NumMisses;        // lookups that had to search
+	int NumEvictions;     // entries evicted to stay under MaxBytes
+	int NumInvalidations; // entries dropped by grid edits
+
+	inline PathCache()
+		: Finder(0), MaxBytes(0), NumBytes(0), InvalidateRegion(true),
+		  NumHits(0), NumMisses(0), NumEvictions(0), NumInvalidations(0)
+	{
+	}
+	inline ~PathCache() { Destroy(); }
+	PathCache(const PathCache& other)          = delete; // NOCOPY
+	PathCache& operator=(const PathCache& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Creates the cache for the grid of the pathfinder and listens to its changes
+	 * @param maxBytes Memory cap of the cached paths
+	 */
+	void Create(PathfinderAstar* finder, size_t maxBytes = 1024 * 1024);
+	void Destroy();
+
+	/**
+	 * @brief Returns the cached path or searches it with Process() and caches the result.
+	 *        The result is identical to PathfinderAstar::Process(), [end .. start]
+	 * @param agentClass Caller defined class of the agent, paths are only shared within a class
+	 * @param agentSize Footprint of the agent in cells, same as PathfinderAstar::Process().
+	 *                  Must be the same for every agent of the class
+	 * @return TRUE if a path was found
+	 */
+	bool Process(int start, int end, int agentClass, PfVector<Vector2>& outPath, int agentSize = 1);
+
+	/** @return TRUE if the path was cached and appended to outPath. Counts as a hit or a miss */
+	bool Find(int start, int end, int agentClass, PfVector<Vector2>& outPath);
+
+	/** @brief Caches a path [end .. start] of an agentSize agent, evicting old entries if MaxBytes is exceeded */
+	void Insert(int start, int end, int agentClass, const PfVector<Vector2>& path, int agentSize = 1);
+
+	/** @brief Drops all cached paths, the stats are kept */
+	void Clear();
+
+	/** @brief Resets the hit, miss, eviction and invalidation counters */
+	void ResetStats();
+
+	/** @return Hits / lookups, 0 if there were no lookups */
+	inline float HitRate() const
+	{
+		int lookups = NumHits + NumMisses;
+		return lookups ? float(NumHits) / lookups : 0.0f;
+	}
+
+	/** @return Number of cached paths */
+	inline int Size() const { return int(Index.size()); }
+
+	// AstarGridListener
+	void OnGridChanged(int x, int y, int w, int h) override;
+
+	void erase(EntryList::iterator it);
+	bool crosses(const PathCacheEntry& entry, int x, int y, int w, int h) const;
+	static size_t entry_bytes(const PathCacheEntry& entry);
+};
+
+
+#endif // PATHFINDER_CACHE_H
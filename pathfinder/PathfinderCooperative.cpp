@@ -0,0 +1,348 @@
+#include "PathfinderCooperative.h"
+#include "AstarPolicies.h"
+#include <algorithm>
+
+
+	void SpaceTimeTable::create(int capacity)
+	{
+		destroy();
+		int size = 64, bits = 6;
+		while (size < capacity * 2)
+			size <<= 1, ++bits;
+		Slots = (Slot*)calloc(size, sizeof(Slot)); // Gen 0 is never current
+		Mask  = uint(size - 1);
+		Shift = 32 - bits;
+		Gen   = 1;
+		Count = 0;
+	}
+
+	void SpaceTimeTable::destroy()
+	{
+		if (Slots) free(Slots), Slots = NULL;
+		Mask  = 0;
+		Shift = 32;
+		Count = 0;
+	}
+
+	void SpaceTimeTable::clear()
+	{
+		Count = 0;
+		if (++Gen == 0) // generation overflow, all old stamps have to be cleared
+		{
+			memset(Slots, 0, sizeof(Slot) * (Mask + 1));
+			Gen = 1;
+		}
+	}
+
+	int SpaceTimeTable::get(int cell, int time) const
+	{
+		if (!Slots)
+			return -1;
+		uint k = key(cell, time);
+		for (uint i = slot_of(k); ; i = (i + 1) & Mask)
+		{
+			const Slot& s = Slots[i];
+			if (s.Gen != Gen) return -1;
+			if (s.Key == k)   return s.Value;
+		}
+	}
+
+	void SpaceTimeTable::set(int cell, int time, int value)
+	{
+		if (uint(Count + 1) * 2 > Mask + 1) // keep the load under 50%, so probe chains stay short
+		{
+			Slot* old = Slots;
+			uint oldSize = old ? Mask + 1 : 0;
+			uint oldGen  = Gen;
+			Slots = NULL;
+			create(oldSize ? int(oldSize) : 32);
+			for (uint i = 0; i < oldSize; ++i)
+				if (old[i].Gen == oldGen)
+					set(int(old[i].Key >> TimeBits), int(old[i].Key & MaxTime), old[i].Value);
+			if (old) free(old);
+		}
+
+		uint k = key(cell, time);
+		for (uint i = slot_of(k); ; i = (i + 1) & Mask)
+		{
+			Slot& s = Slots[i];
+			if (s.Gen != Gen)
+			{
+				s.Key   = k;
+				s.Value = value;
+				s.Gen   = Gen;
+				++Count;
+				return;
+			}
+			if (s.Key == k)
+			{
+				s.Value = value;
+				return;
+			}
+		}
+	}
+
+
+
+
+	// neighbor offsets N, NE, E, SE, S, SW, W, NW and waiting in place
+	static const int MoveX[9] = { 0, 1, 1, 1, 0,-1,-1,-1, 0 };
+	static const int MoveY[9] = { 1, 1, 0,-1,-1,-1, 0, 1, 0 };
+	static const int MoveWait = 8;
+
+	// heap order of the open list: lowest FScore first, deeper nodes first on ties
+	struct NodeOrder
+	{
+		const PfVector<CooperativePlanner::Node>& Nodes;
+		inline NodeOrder(const PfVector<CooperativePlanner::Node>& nodes) : Nodes(nodes) {}
+		inline bool operator()(int a, int b) const
+		{
+			const CooperativePlanner::Node& na = Nodes[a];
+			const CooperativePlanner::Node& nb = Nodes[b];
+			return na.FScore != nb.FScore ? na.FScore > nb.FScore : na.Time < nb.Time;
+		}
+	};
+
+	void CooperativePlanner::Create(PathfinderAstar* finder, int window)
+	{
+		Destroy();
+		if (window < 2) window = 2;
+		if (window > SpaceTimeTable::MaxTime) window = SpaceTimeTable::MaxTime;
+		Finder = finder;
+		Window = window;
+		ReplanInterval = window / 2;
+		Reserved.create(1024);
+		Visited.create(1024);
+	}
+
+	void CooperativePlanner::Destroy()
+	{
+		Agents.clear();
+		Plans.deallocate();
+		Order.deallocate();
+		Reserved.destroy();
+		Visited.destroy();
+		Nodes.deallocate();
+		Open.deallocate();
+		Finder = NULL;
+		Step = 0;
+		Time = 0;
+	}
+
+	int CooperativePlanner::AddAgent(int start, int goal, int priority)
+	{
+		int agent = int(Agents.size());
+		Agents.emplace_back();
+		CoopAgent& a = Agents.back();
+		a.Cell     = start;
+		a.Goal     = goal;
+		a.Priority = priority;
+		search_guide(a);
+
+		// wait in place until the next window plans it with the others
+		for (int t = 0; t <= Window; ++t)
+			Plans.push_back(start);
+		if (Step)
+			for (int t = Step; t <= Window; ++t)
+				if (Reserved.get(start, t) == -1)
+					Reserved.set(start, t, agent);
+		return agent;
+	}
+
+	void CooperativePlanner::SetGoal(int agent, int goal)
+	{
+		CoopAgent& a = Agents[agent];
+		a.Goal = goal;
+		search_guide(a); // the reserved window is kept, the new goal is planned by the next window
+	}
+
+	void CooperativePlanner::Tick()
+	{
+		if (Agents.empty())
+			return;
+		if (Step == 0 || Step >= ReplanInterval)
+			plan_all();
+
+		++Step;
+		++Time;
+		const int stride = Window + 1;
+		for (int i = 0, count = int(Agents.size()); i < count; ++i)
+		{
+			CoopAgent& a = Agents[i];
+			a.Cell = Plans[i * stride + Step];
+
+			// follow our progress along the guide, the agent may have waited or stepped aside
+			int last = a.GuideIndex + Window + 1;
+			if (last > int(a.Guide.size())) last = int(a.Guide.size());
+			for (int g = a.GuideIndex; g < last; ++g)
+				if (a.Guide[g] == a.Cell) { a.GuideIndex = g; break; }
+		}
+	}
+
+	int CooperativePlanner::NumArrived() const
+	{
+		int arrived = 0;
+		for (const CoopAgent& a : Agents)
+			if (a.Cell == a.Goal) ++arrived;
+		return arrived;
+	}
+
+	int CooperativePlanner::PlannedCell(int agent, int steps) const
+	{
+		int t = Step + steps;
+		if (t > Window) t = Window;
+		return Plans[agent * (Window + 1) + t];
+	}
+
+	void CooperativePlanner::plan_all()
+	{
+		Reserved.clear();
+		Order.clear();
+		for (int i = 0, count = int(Agents.size()); i < count; ++i)
+			Order.push_back(i);
+
+		// agents on their goal plan last, they can step aside for the ones still moving
+		const std::vector<CoopAgent>& agents = Agents;
+		std::sort(Order.begin(), Order.end(), [&](int a, int b)
+		{
+			const CoopAgent& aa = agents[a];
+			const CoopAgent& ab = agents[b];
+			bool arrivedA = aa.Cell == aa.Goal, arrivedB = ab.Cell == ab.Goal;
+			if (arrivedA != arrivedB)       return arrivedB;
+			if (aa.Priority != ab.Priority) return aa.Priority > ab.Priority;
+			return a < b;
+		});
+
+		// nobody can enter a cell on the first step before its agent had a chance to plan,
+		// so every agent can at least wait for one step
+		for (int i = 0, count = int(Agents.size()); i < count; ++i)
+		{
+			Reserved.set(Agents[i].Cell, 0, i);
+			Reserved.set(Agents[i].Cell, 1, i);
+		}
+		for (int i = 0; i < Order.size(); ++i)
+			plan_window(Order[i]);
+		++NumWindows;
+		Step = 0;
+	}
+
+	void CooperativePlanner::plan_window(int agent)
+	{
+		const CoopAgent& a = Agents[agent];
+		const AstarGrid& grid = Finder->Grid;
+		const int width  = grid.Width;
+		const int height = grid.Height;
+		const ushort* planes = grid.Planes;
+		const int target = guide_target(a);
+		const int tx = grid.x_of(target), ty = grid.y_of(target);
+		const NodeOrder order(Nodes);
+
+		Nodes.clear();
+		Open.clear();
+		Visited.clear();
+		++NumSearches;
+		push_node(a.Cell, 0, 0, octile(grid.x_of(a.Cell) - tx, grid.y_of(a.Cell) - ty), -1);
+
+		int best    = -1;
+		int deepest = 0; // fallback if the window can't be completed
+		while (!Open.empty())
+		{
+			std::pop_heap(Open.begin(), Open.end(), order);
+			int index;
+			Open.pop(index);
+			const Node n = Nodes[index]; // copy, push_node() can move the nodes
+			if (Visited.get(n.Cell, n.Time) != index)
+				continue; // replaced by a cheaper node
+			if (n.Time == Window)
+			{
+				best = index;
+				break;
+			}
+			if (n.Time > Nodes[deepest].Time)
+				deepest = index;
+			++NumExpanded;
+
+			const int x = grid.x_of(n.Cell), y = grid.y_of(n.Cell);
+			const int t = n.Time + 1;
+			const int mover = Reserved.get(n.Cell, t); // agent entering our cell, we can't swap places with it
+			for (int dir = 0; dir <= MoveWait; ++dir)
+			{
+				int nx = x + MoveX[dir], ny = y + MoveY[dir];
+				if (unsigned(nx) >= unsigned(width) || unsigned(ny) >= unsigned(height))
+					continue;
+				int cell = ny * width + nx;
+				if (planes[cell] == 1)
+					continue; // collision plane
+				int owner = Reserved.get(cell, t);
+				if (owner != -1 && owner != agent)
+					continue; // reserved by another agent
+				if (dir != MoveWait && mover != -1 && Reserved.get(cell, n.Time) == mover)
+					continue;
+
+				int gain = dir == MoveWait ? (cell == a.Goal ? 0 : 8) : (dir & 1) ? 11 : 8;
+				int gscore = n.GScore + gain;
+				int seen = Visited.get(cell, t);
+				if (seen != -1 && Nodes[seen].GScore <= gscore)
+					continue;
+				push_node(cell, t, gscore, octile(nx - tx, ny - ty), index);
+			}
+		}
+
+		int* plan = &Plans[agent * (Window + 1)];
+		if (best == -1) // boxed in by the reservations: go as far as we can, then wait there
+		{
+			++NumBlocked;
+			best = deepest;
+			for (int t = Nodes[best].Time + 1; t <= Window; ++t)
+				plan[t] = Nodes[best].Cell;
+		}
+		for (int i = best; i != -1; i = Nodes[i].Prev)
+			plan[Nodes[i].Time] = Nodes[i].Cell;
+
+		if (plan[1] != a.Cell)
+			Reserved.set(a.Cell, 1, -1); // release the wait reserved by plan_all()
+		for (int t = 0; t <= Window; ++t)
+		{
+			int owner = Reserved.get(plan[t], t);
+			if (owner == -1 || owner == agent) // a blocked plan must not take over the reservations of others
+				Reserved.set(plan[t], t, agent);
+		}
+	}
+
+	void CooperativePlanner::search_guide(CoopAgent& a)
+	{
+		a.Guide.clear();
+		a.GuideIndex = 0;
+
+		PfVector<Vector2> path;
+		++NumGuides;
+		if (a.Goal != -1 && Finder->Process(Finder->Context, a.Cell, a.Goal, path, NULL))
+		{
+			for (int i = path.size() - 1; i >= 0; --i) // [end .. start] -> [start .. end]
+			{
+				Vector2i v = Finder->ToVirtualCoord(path[i]);
+				a.Guide.push_back(Finder->Grid.index(v.x, v.y));
+			}
+		}
+		else
+		{
+			a.Guide.push_back(a.Cell); // no way to the goal, stay where we are
+		}
+	}
+
+	int CooperativePlanner::guide_target(const CoopAgent& a) const
+	{
+		int index = a.GuideIndex + Window;
+		int last  = int(a.Guide.size()) - 1;
+		return a.Guide[index < last ? index : last];
+	}
+
+	void CooperativePlanner::push_node(int cell, int time, int gscore, int hscore, int prev)
+	{
+		Node n = { cell, time, gscore, gscore + hscore, prev };
+		int index = Nodes.size();
+		Nodes.push_back(n);
+		Visited.set(cell, time, index);
+		Open.push_back(index);
+		std::push_heap(Open.begin(), Open.end(), NodeOrder(Nodes));
+	}
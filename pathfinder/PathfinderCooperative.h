@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PATHFINDER_COOPERATIVE_H
+#define PATHFINDER_COOPERATIVE_H
+
+#include "PathfinderAstar.h"
+#include <vector>
+
+/**
+ * Open addressing hash of (cell, time step) -> int value.
+ * Slots are stamped with a generation like AstarState::OpenID, so clear() is O(1)
+ * and the whole table can be dropped at the start of every planning window
+ */
+struct SpaceTimeTable
+{
+	struct Slot
+	{
+		uint Key;   // (cell << TimeBits) | time
+		int  Value;
+		uint Gen;   // slot is only valid if Gen == SpaceTimeTable::Gen
+	};
+
+	static const int TimeBits = 6; // time steps [0, 63] within a window
+	static const int MaxTime  = (1 << TimeBits) - 1;
+
+	Slot* Slots;
+	uint  Mask;  // number of slots - 1, always a power of 2
+	int   Shift; // 32 - log2(number of slots), for the multiplicative hash
+	uint  Gen;   // generation of the current contents
+	int   Count; // number of valid slots
+
+	inline SpaceTimeTable() : Slots(0), Mask(0), Shift(32), Gen(1), Count(0) {}
+	inline ~SpaceTimeTable() { destroy(); }
+	SpaceTimeTable(const SpaceTimeTable& other)          = delete; // NOCOPY
+	SpaceTimeTable& operator=(const SpaceTimeTable& rhs) = delete; // NOCOPY
+
+	/** @brief Allocates room for at least [capacity] entries at <= 50% load */
+	void create(int capacity);
+	void destroy();
+
+	/** @brief Drops all entries by bumping the generation */
+	void clear();
+
+	/** @return Value stored for [cell, time], -1 if none */
+	int get(int cell, int time) const;
+
+	/** @brief Stores or overwrites the value of [cell, time], grows the table if needed */
+	void set(int cell, int time, int value);
+
+	/** @return Total number of bytes allocated by the table */
+	inline size_t bytes() const { return Slots ? sizeof(Slot) * (Mask + 1) : 0; }
+
+	static inline uint key(int cell, int time) { return (uint(cell) << TimeBits) | uint(time); }
+	inline uint slot_of(uint key) const { return (key * 0x9E3779B1u) >> Shift; }
+};
+
+// a unit moving one cell (or waiting) per time step
+struct CoopAgent
+{
+	int Cell;       // current cell index
+	int Goal;       // goal cell index
+	int Priority;   // higher priorities plan first and get the first pick of cells
+	std::vector<int> Guide; // static path [start .. goal] from Process(), leads the search beyond the window
+	int GuideIndex; // index of the guide cell the agent is at or last passed
+};
+
+/**
+ * Windowed Hierarchical Cooperative A* (Silver 2005) over the AstarGrid of a PathfinderAstar.
+ * Every ReplanInterval steps all agents plan Window steps ahead in priority order.
+ * Each agent searches in space-time, avoiding the cells and swaps reserved by the agents
+ * planned before it, then reserves its own window. The reservation table is dropped
+ * in bulk at the start of every window.
+ *
+ * Beyond the window an agent is guided by its static Process() path: the window search
+ * heads for the guide cell Window steps ahead instead of RRA*, which keeps the cost per
+ * agent at a single short search instead of a full abstract distance table.
+ * @note Not thread safe
+ */
+struct CooperativePlanner
+{
+	// space-time search node
+	struct Node
+	{
+		int Cell;
+		int Time;
+		int GScore;
+		int FScore;
+		int Prev; // index of the previous node, -1 at the start
+	};
+
+	PathfinderAstar* Finder;
+	std::vector<CoopAgent> Agents;
+	PfVector<int> Plans;       // Window + 1 cells for every agent: the cell at each step of the current window
+	PfVector<int> Order;       // agent planning order of the current window
+	SpaceTimeTable Reserved;   // [cell, time] -> agent that reserved it
+	SpaceTimeTable Visited;    // [cell, time] -> best search node, reused by every window search
+	PfVector<Node> Nodes;      // search nodes of the current window search
+	PfVector<int>  Open;       // heap of open node indices
+	int Window;                // number of steps planned ahead, <= SpaceTimeTable::MaxTime
+	int ReplanInterval;        // number of steps executed before the next window
+	int Step;                  // steps executed in the current window
+	int Time;                  // total steps executed
+
+	int NumWindows;   // planning passes over all agents
+	int NumSearches;  // window searches
+	int NumExpanded;  // space-time nodes expanded by all window searches
+	int NumBlocked;   // window searches that found no free path; those agents wait in place
+	int NumGuides;    // static Process() searches for the guide paths
+
+	inline CooperativePlanner()
+		: Finder(0), Window(16), ReplanInterval(8), Step(0), Time(0),
+		  NumWindows(0), NumSearches(0), NumExpanded(0), NumBlocked(0), NumGuides(0)
+	{
+	}
+	inline ~CooperativePlanner() { Destroy(); }
+	CooperativePlanner(const CooperativePlanner& other)          = delete; // NOCOPY
+	CooperativePlanner& operator=(const CooperativePlanner& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Creates the planner for the grid of the pathfinder
+	 * @param window Number of steps planned ahead, clamped to [2, SpaceTimeTable::MaxTime].
+	 *               Agents execute half of every window before it's replanned
+	 */
+	void Create(PathfinderAstar* finder, int window = 16);
+	void Destroy();
+
+	/**
+	 * @brief Adds an agent standing on the start cell
+	 * @return Index of the new agent
+	 */
+	int AddAgent(int start, int goal, int priority = 0);
+
+	/** @brief Gives the agent a new goal, its guide path is searched again */
+	void SetGoal(int agent, int goal);
+
+	/**
+	 * @brief Moves every agent one step along its plan. At the start of a window, all
+	 *        agents are planned again in priority order
+	 */
+	void Tick();
+
+	/** @return Number of agents standing on their goal */
+	int NumArrived() const;
+
+	/** @return Cell of the agent [steps] steps ahead in the current plan, clamped to the window */
+	int PlannedCell(int agent, int steps) const;
+
+	void plan_all();
+	void plan_window(int agent);
+	void search_guide(CoopAgent& a);
+	int  guide_target(const CoopAgent& a) const;
+	void push_node(int cell, int time, int gscore, int hscore, int prev);
+};
+
+
+#endif // PATHFINDER_COOPERATIVE_H
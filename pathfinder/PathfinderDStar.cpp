@@ -0,0 +1,360 @@
+#include "PathfinderDStar.h"
+#include "AstarPolicies.h"
+
+
+	void DStarQueue::insert(DStarState* states, int cell, __int64 key)
+	{
+		if (Size == Capacity)
+		{
+			Capacity = Capacity ? Capacity * 2 : 1024;
+			Heap = (entry*)realloc(Heap, sizeof(entry) * Capacity);
+		}
+		Heap[Size].key  = key;
+		Heap[Size].cell = cell;
+		states[cell].HeapIndex = Size;
+		sift_up(states, Size++);
+	}
+
+	void DStarQueue::update(DStarState* states, int cell, __int64 key)
+	{
+		int index = states[cell].HeapIndex;
+		__int64 old = Heap[index].key;
+		Heap[index].key = key;
+		if (key < old) sift_up(states, index);
+		else           sift_down(states, index);
+	}
+
+	void DStarQueue::remove(DStarState* states, int cell)
+	{
+		int index = states[cell].HeapIndex;
+		states[cell].HeapIndex = -1;
+		if (index == --Size)
+			return;
+		__int64 old = Heap[index].key;
+		Heap[index] = Heap[Size];
+		states[Heap[index].cell].HeapIndex = index;
+		if (Heap[index].key < old) sift_up(states, index);
+		else                       sift_down(states, index);
+	}
+
+	void DStarQueue::sift_up(DStarState* states, int index)
+	{
+		entry e = Heap[index];
+		while (index > 0)
+		{
+			int parent = (index - 1) >> 1;
+			if (Heap[parent].key <= e.key)
+				break;
+			Heap[index] = Heap[parent];
+			states[Heap[index].cell].HeapIndex = index;
+			index = parent;
+		}
+		Heap[index] = e;
+		states[e.cell].HeapIndex = index;
+	}
+
+	void DStarQueue::sift_down(DStarState* states, int index)
+	{
+		entry e = Heap[index];
+		for (int child; (child = (index << 1) + 1) < Size; )
+		{
+			if (child + 1 < Size && Heap[child + 1].key < Heap[child].key)
+				++child;
+			if (e.key <= Heap[child].key)
+				break;
+			Heap[index] = Heap[child];
+			states[Heap[index].cell].HeapIndex = index;
+			index = child;
+		}
+		Heap[index] = e;
+		states[e.cell].HeapIndex = index;
+	}
+
+
+
+
+	void PathfinderDStarLite::Create(PathfinderAstar* finder)
+	{
+		Destroy();
+		Finder = finder;
+		Finder->AddListener(this);
+		int count = finder->Grid.Width * finder->Grid.Height;
+		States  = (DStarState*)malloc(sizeof(DStarState) * count);
+		Invalid = true;
+	}
+
+	void PathfinderDStarLite::Destroy()
+	{
+		if (States)
+		{
+			free(States);
+			States = NULL;
+		}
+		if (Finder)
+		{
+			Finder->RemoveListener(this);
+			Finder = NULL;
+		}
+		Queue.clear();
+		ChangedCells.clear();
+		Start = End = LastStart = -1;
+		Invalid = true;
+	}
+
+	size_t PathfinderDStarLite::Bytes() const
+	{
+		size_t count = Finder ? size_t(Finder->Grid.Width) * Finder->Grid.Height : 0;
+		return sizeof(DStarState) * count + sizeof(DStarQueue::entry) * Queue.Capacity
+			+ sizeof(int) * ChangedCells.capacity();
+	}
+
+	bool PathfinderDStarLite::SetStart(const Vector2& worldXY)
+	{
+		Vector2i pos = Finder->ToVirtualCoord(worldXY);
+		return SetStart(pos.x, pos.y);
+	}
+	bool PathfinderDStarLite::SetStart(int x, int y)
+	{
+		int n = Finder->Grid.index(x, y);
+		if (n != -1 && n != Start && n != End) { // valid && not same && not same as end
+			Start = n; // moving the unit keeps the search tree
+			return true;
+		}
+		return false;
+	}
+
+	bool PathfinderDStarLite::SetEnd(const Vector2& worldXY)
+	{
+		Vector2i pos = Finder->ToVirtualCoord(worldXY);
+		return SetEnd(pos.x, pos.y);
+	}
+	bool PathfinderDStarLite::SetEnd(int x, int y)
+	{
+		int n = Finder->Grid.index(x, y);
+		if (n != -1 && n != End && n != Start) { // valid && not same && not same as start
+			End = n;
+			Invalid = true; // the search tree is rooted at End
+			return true;
+		}
+		return false;
+	}
+
+	void PathfinderDStarLite::OnGridChanged(int x, int y, int w, int h)
+	{
+		const AstarGrid& grid = Finder->Grid;
+		int x0 = x < 0 ? 0 : x, x1 = x + w > grid.Width  ? grid.Width  : x + w;
+		int y0 = y < 0 ? 0 : y, y1 = y + h > grid.Height ? grid.Height : y + h;
+		for (int cy = y0; cy < y1; ++cy)
+		for (int cx = x0; cx < x1; ++cx)
+			ChangedCells.push_back(cy * grid.Width + cx);
+	}
+
+
+
+
+	// octile distance, consistent with the edge costs
+	int PathfinderDStarLite::heuristic(int a, int b) const
+	{
+		const AstarGrid& grid = Finder->Grid;
+		return octile(grid.x_of(a) - grid.x_of(b), grid.y_of(a) - grid.y_of(b));
+	}
+
+	__int64 PathfinderDStarLite::calculate_key(int cell) const
+	{
+		const DStarState& s = States[cell];
+		int m = s.G < s.Rhs ? s.G : s.Rhs;
+		__int64 k1 = (__int64)m + heuristic(Start, cell) + KeyModifier;
+		return (k1 << 32) | unsigned(m);
+	}
+
+	int PathfinderDStarLite::lookahead(int cell) const
+	{
+		const AstarGrid& grid = Finder->Grid;
+		const ushort* planes = grid.Planes;
+		if (planes[cell] == 1)
+			return Infinity;
+
+		int best = Infinity;
+		int x = grid.x_of(cell), y = grid.y_of(cell);
+		for (int i = 0; i < 8; ++i)
+		{
+			int n = grid.index(x + AstarGrid::NeighborX[i], y + AstarGrid::NeighborY[i]);
+			if (n == -1 || planes[n] == 1 || States[n].G >= Infinity)
+				continue;
+			int cost = States[n].G + ((i & 1) ? 11 : 8);
+			if (cost < best) best = cost;
+		}
+		return best;
+	}
+
+	void PathfinderDStarLite::update_vertex(int cell)
+	{
+		DStarState& s = States[cell];
+		if (s.G != s.Rhs)
+		{
+			if (s.HeapIndex != -1) Queue.update(States, cell, calculate_key(cell));
+			else                   Queue.insert(States, cell, calculate_key(cell));
+		}
+		else if (s.HeapIndex != -1)
+		{
+			Queue.remove(States, cell);
+		}
+	}
+
+	void PathfinderDStarLite::initialize()
+	{
+		for (int i = 0, count = Finder->Grid.Width * Finder->Grid.Height; i < count; ++i)
+		{
+			States[i].G   = Infinity;
+			States[i].Rhs = Infinity;
+			States[i].HeapIndex = -1;
+		}
+		Queue.clear();
+		ChangedCells.clear();
+		KeyModifier = 0;
+		LastStart   = Start;
+		States[End].Rhs = 0;
+		Queue.insert(States, End, calculate_key(End));
+		Invalid = false;
+	}
+
+	void PathfinderDStarLite::compute_shortest_path()
+	{
+		const AstarGrid& grid = Finder->Grid;
+		const ushort* planes = grid.Planes;
+		DStarState* states = States;
+		while (!Queue.empty())
+		{
+			const DStarState& start = states[Start];
+			if (Queue.top_key() >= calculate_key(Start) && start.Rhs <= start.G)
+				break;
+
+			int u = Queue.top();
+			__int64 oldKey = Queue.top_key();
+			__int64 newKey = calculate_key(u);
+			DStarState& s = states[u];
+			if (oldKey < newKey)
+			{
+				Queue.update(states, u, newKey); // key is outdated since the unit moved
+				continue;
+			}
+
+			++NumRepaired;
+			int x = grid.x_of(u), y = grid.y_of(u);
+			if (s.G > s.Rhs) // overconsistent: cost-to-goal got lower
+			{
+				s.G = s.Rhs;
+				Queue.remove(states, u);
+				for (int i = 0; i < 8; ++i)
+				{
+					int p = grid.index(x + AstarGrid::NeighborX[i], y + AstarGrid::NeighborY[i]);
+					if (p == -1 || p == End || planes[p] == 1)
+						continue;
+					int cost = s.G + ((i & 1) ? 11 : 8);
+					if (cost < states[p].Rhs)
+					{
+						states[p].Rhs = cost;
+						update_vertex(p);
+					}
+				}
+			}
+			else // underconsistent: cost-to-goal got higher, so everything that relied on u is recalculated
+			{
+				int oldG = s.G;
+				s.G = Infinity;
+				for (int i = 0; i < 8; ++i)
+				{
+					int p = grid.index(x + AstarGrid::NeighborX[i], y + AstarGrid::NeighborY[i]);
+					if (p == -1 || p == End || planes[p] == 1)
+						continue;
+					if (states[p].Rhs == oldG + ((i & 1) ? 11 : 8))
+					{
+						states[p].Rhs = lookahead(p);
+						++NumUpdated;
+					}
+					update_vertex(p);
+				}
+				if (u != End)
+				{
+					s.Rhs = lookahead(u);
+					++NumUpdated;
+				}
+				update_vertex(u);
+			}
+		}
+	}
+
+	bool PathfinderDStarLite::Process(PfVector<Vector2>& outPath)
+	{
+		NumRepaired = 0;
+		NumUpdated  = 0;
+		if (Start == -1 || End == -1)
+			return false;
+		if (Invalid)
+			initialize();
+
+		if (Start != LastStart) // keys already in the queue stay valid lower bounds
+		{
+			KeyModifier += heuristic(LastStart, Start);
+			LastStart = Start;
+		}
+
+		// only the changed cells and their neighbors have different edge costs
+		const AstarGrid& grid = Finder->Grid;
+		for (int i = 0; i < ChangedCells.size(); ++i)
+		{
+			int cell = ChangedCells[i];
+			int x = grid.x_of(cell), y = grid.y_of(cell);
+			for (int j = -1; j < 8; ++j)
+			{
+				int u = j == -1 ? cell : grid.index(x + AstarGrid::NeighborX[j], y + AstarGrid::NeighborY[j]);
+				if (u == -1 || u == End)
+					continue;
+				States[u].Rhs = lookahead(u);
+				++NumUpdated;
+				update_vertex(u);
+			}
+		}
+		ChangedCells.clear();
+
+		const ushort* planes = grid.Planes;
+		if (planes[Start] != planes[End] || planes[Start] == 1)
+			return false; // no possible path between these two, or collision planes(1)
+
+		compute_shortest_path();
+		if (States[Start].Rhs >= Infinity)
+			return false;
+
+		// follow the cheapest neighbors from start to end, then output it [end .. start]
+		int first = outPath.size();
+		int cell  = Start;
+		outPath.push_back(Finder->ToScreenCoordCentered(cell));
+		for (int steps = grid.Width * grid.Height; cell != End; --steps)
+		{
+			int best = -1, bestCost = Infinity;
+			int x = grid.x_of(cell), y = grid.y_of(cell);
+			for (int i = 0; i < 8; ++i)
+			{
+				int n = grid.index(x + AstarGrid::NeighborX[i], y + AstarGrid::NeighborY[i]);
+				if (n == -1 || planes[n] == 1 || States[n].G >= Infinity)
+					continue;
+				int cost = States[n].G + ((i & 1) ? 11 : 8);
+				if (cost < bestCost) best = n, bestCost = cost;
+			}
+			if (best == -1 || steps == 0)
+			{
+				outPath.Size = first;
+				return false;
+			}
+			cell = best;
+			outPath.push_back(Finder->ToScreenCoordCentered(cell));
+		}
+
+		for (int i = first, j = outPath.size() - 1; i < j; ++i, --j)
+		{
+			Vector2 tmp = outPath[i];
+			outPath[i] = outPath[j];
+			outPath[j] = tmp;
+		}
+		return true;
+	}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PATHFINDER_DSTAR_H
+#define PATHFINDER_DSTAR_H
+
+#include "PathfinderAstar.h"
+
+/**
+ * Per-cell state of the D* Lite search tree, which is kept between queries
+ */
+struct DStarState
+{
+	int G;         // cost-to-goal of the last expansion
+	int Rhs;       // one-step lookahead cost-to-goal: min(c(s, s') + G(s'))
+	int HeapIndex; // position in DStarQueue, -1 if not queued
+};
+
+/**
+ * Indexed binary min-heap of cells ordered by the lexicographic D* Lite key [k1, k2]
+ */
+struct DStarQueue
+{
+	struct entry
+	{
+		__int64 key; // (k1 << 32) | k2
+		int cell;
+	};
+	entry* Heap;
+	int Size;
+	int Capacity;
+
+	inline DStarQueue() : Heap(0), Size(0), Capacity(0) {}
+	inline ~DStarQueue() { if (Heap) free(Heap); }
+	DStarQueue(const DStarQueue& other)          = delete; // NOCOPY
+	DStarQueue& operator=(const DStarQueue& rhs) = delete; // NOCOPY
+
+	inline bool empty() const { return Size == 0; }
+	inline int size() const { return Size; }
+	inline __int64 top_key() const { return Size ? Heap[0].key : 0x7fffffffffffffffLL; }
+	inline int top() const { return Heap[0].cell; }
+	inline void clear() { Size = 0; }
+
+	void insert(DStarState* states, int cell, __int64 key);
+	void update(DStarState* states, int cell, __int64 key);
+	void remove(DStarState* states, int cell);
+	void sift_up(DStarState* states, int index);
+	void sift_down(DStarState* states, int index);
+};
+
+/**
+ * D* Lite incremental planner over the AstarGrid of a PathfinderAstar.
+ * Searches backwards from End, so when the unit moves (SetStart) or cells change
+ * (PathfinderAstar::SetBlocked), only the affected part of the search tree is repaired.
+ * @note Changing End invalidates the whole search tree
+ */
+struct PathfinderDStarLite : public AstarGridListener
+{
+	PathfinderAstar* Finder;
+	DStarState* States;  // per-cell search state, indexed the same as AstarGrid::Planes
+	DStarQueue  Queue;
+	int Start;           // cell index of the unit, -1 if not set
+	int End;             // cell index of the destination, -1 if not set
+	int LastStart;       // Start at the time of the last key modifier update
+	int KeyModifier;     // km: accumulated heuristic drift since the search tree was built
+	bool Invalid;        // search tree must be rebuilt from scratch
+	PfVector<int> ChangedCells; // cells changed since the last Process()
+
+	int NumRepaired;     // number of nodes expanded by the last Process()
+	int NumUpdated;      // number of nodes whose lookahead was recalculated by the last Process()
+
+	static const int Infinity = 0x3fffffff;
+
+	inline PathfinderDStarLite()
+		: Finder(0), States(0), Start(-1), End(-1), LastStart(-1), KeyModifier(0),
+		  Invalid(true), NumRepaired(0), NumUpdated(0)
+	{
+	}
+	inline ~PathfinderDStarLite() { Destroy(); }
+	PathfinderDStarLite(const PathfinderDStarLite& other)          = delete; // NOCOPY
+	PathfinderDStarLite& operator=(const PathfinderDStarLite& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Allocates the search tree for the grid of the pathfinder and listens to its changes
+	 */
+	void Create(PathfinderAstar* finder);
+	void Destroy();
+
+	/** @return Total number of bytes allocated by the planner */
+	size_t Bytes() const;
+
+	bool SetStart(int x, int y);
+	bool SetEnd(int x, int y);
+	bool SetStart(const Vector2& worldXY);
+	bool SetEnd(const Vector2& worldXY);
+
+	/**
+	 * @brief Repairs the search tree after moves and cell changes, then extracts the path
+	 * @param outPath Resulting path in screen coordinates [end .. start], same as PathfinderAstar::Process()
+	 * @return TRUE if a path exists
+	 */
+	bool Process(PfVector<Vector2>& outPath);
+
+	// AstarGridListener
+	void OnGridChanged(int x, int y, int w, int h) override;
+
+	void initialize();
+	void compute_shortest_path();
+	void update_vertex(int cell);
+	int  lookahead(int cell) const;
+	__int64 calculate_key(int cell) const;
+	int  heuristic(int a, int b) const;
+};
+
+
+#endif // PATHFINDER_DSTAR_H
@@ -0,0 +1,194 @@
+#include "PathfinderFlowField.h"
+
+
+
+	void FlowField::destroy()
+	{
+		if (Cost) free(Cost), Cost = NULL;
+		if (Dirs) free(Dirs), Dirs = NULL;
+		Goal = -1;
+		NumSettled = 0;
+	}
+
+	Vector2 FlowField::direction(int cell) const
+	{
+		static const float d = 0.70710678f;
+		static const Vector2 dirs[8] = {
+			Vector2(0.0f, 1.0f), Vector2( d, d), Vector2( 1.0f, 0.0f), Vector2( d,-d),
+			Vector2(0.0f,-1.0f), Vector2(-d,-d), Vector2(-1.0f, 0.0f), Vector2(-d, d),
+		};
+		int dir = Dirs[cell];
+		return dir == NoDirection ? Vector2(0.0f, 0.0f) : dirs[dir];
+	}
+
+
+
+
+	void FlowFieldCache::Create(PathfinderAstar* finder, int maxFields)
+	{
+		Destroy();
+		Finder    = finder;
+		Fields    = new FlowField[maxFields];
+		NumFields = maxFields;
+		Finder->AddListener(this);
+	}
+
+	void FlowFieldCache::Destroy()
+	{
+		if (Fields)
+		{
+			delete[] Fields;
+			Fields    = NULL;
+			NumFields = 0;
+		}
+		if (Finder)
+		{
+			Finder->RemoveListener(this);
+			Finder = NULL;
+		}
+		for (int i = 0; i < 12; ++i)
+			Buckets[i].clear();
+		UseCounter = 0;
+	}
+
+	size_t FlowFieldCache::Bytes() const
+	{
+		size_t count = Finder ? size_t(Finder->Grid.Width) * Finder->Grid.Height : 0;
+		size_t bytes = 0;
+		for (int i = 0; i < NumFields; ++i)
+			if (Fields[i].Cost)
+				bytes += (sizeof(int) + sizeof(byte)) * count;
+		for (int i = 0; i < 12; ++i)
+			bytes += sizeof(int) * Buckets[i].capacity();
+		return bytes;
+	}
+
+	const FlowField* FlowFieldCache::Get(int x, int y)
+	{
+		return Get(Finder->Grid.index(x, y));
+	}
+
+	const FlowField* FlowFieldCache::Get(int goal)
+	{
+		if (goal == -1 || !Finder->Grid.walkable(goal))
+			return NULL;
+
+		FlowField* victim = NULL; // first free slot or the least recently used field
+		for (int i = 0; i < NumFields; ++i)
+		{
+			FlowField& field = Fields[i];
+			if (field.Goal == goal)
+			{
+				field.LastUsed = ++UseCounter;
+				return &field;
+			}
+			if (!victim || (victim->Goal != -1 && (field.Goal == -1 || field.LastUsed < victim->LastUsed)))
+				victim = &field;
+		}
+
+		build(*victim, goal);
+		victim->LastUsed = ++UseCounter;
+		return victim;
+	}
+
+	const FlowField* FlowFieldCache::Find(int goal) const
+	{
+		for (int i = 0; i < NumFields; ++i)
+			if (Fields[i].Goal == goal && goal != -1)
+				return &Fields[i];
+		return NULL;
+	}
+
+	void FlowFieldCache::Clear()
+	{
+		for (int i = 0; i < NumFields; ++i)
+			Fields[i].Goal = -1; // keep the buffers for the next build
+	}
+
+	void FlowFieldCache::OnGridChanged(int x, int y, int w, int h)
+	{
+		// a field is only affected if it reached a changed cell or one of its neighbors:
+		// blocked cells were reachable before the change, unblocked cells connect to a reachable neighbor
+		const AstarGrid& grid = Finder->Grid;
+		int x0 = x - 1 < 0 ? 0 : x - 1, x1 = x + w + 1 > grid.Width  ? grid.Width  : x + w + 1;
+		int y0 = y - 1 < 0 ? 0 : y - 1, y1 = y + h + 1 > grid.Height ? grid.Height : y + h + 1;
+		for (int i = 0; i < NumFields; ++i)
+		{
+			FlowField& field = Fields[i];
+			if (field.Goal == -1)
+				continue;
+			for (int cy = y0; cy < y1 && field.Goal != -1; ++cy)
+			for (int cx = x0; cx < x1; ++cx)
+			{
+				if (field.reachable(cy * grid.Width + cx))
+				{
+					field.Goal = -1;
+					break;
+				}
+			}
+		}
+	}
+
+
+
+
+	void FlowFieldCache::build(FlowField& field, int goal)
+	{
+		const AstarGrid& grid = Finder->Grid;
+		int count = grid.Width * grid.Height;
+		if (!field.Cost)
+		{
+			field.Cost = (int*)malloc(sizeof(int) * count);
+			field.Dirs = (byte*)malloc(sizeof(byte) * count);
+		}
+		field.Goal = goal;
+		integrate(field);
+		build_directions(field);
+		++NumBuilds;
+	}
+
+	void FlowFieldCache::integrate(FlowField& field)
+	{
+		field.NumSettled = Finder->Grid.dial_sweep(field.Goal, field.Cost, Buckets);
+	}
+
+	void FlowFieldCache::build_directions(FlowField& field)
+	{
+		if (!Finder->WorkerContexts)
+			Finder->CreateWorkers();
+
+		// every cell only reads the final costs of its neighbors, so rows are fully independent
+		const AstarGrid& grid = Finder->Grid;
+		const int width  = grid.Width;
+		const int height = grid.Height;
+		const int* cost  = field.Cost;
+		byte* dirs = field.Dirs;
+		const int rowsPerTask = 16;
+		Finder->Workers.parallel_for((height + rowsPerTask - 1) / rowsPerTask, [=](int /*worker*/, int task)
+		{
+			int yEnd = (task + 1) * rowsPerTask < height ? (task + 1) * rowsPerTask : height;
+			for (int y = task * rowsPerTask; y < yEnd; ++y)
+			{
+				const int* row = cost + y * width;
+				for (int x = 0; x < width; ++x)
+				{
+					int best = FlowField::NoDirection;
+					int c = row[x];
+					if (c != FlowField::Unreachable && c != 0)
+					{
+						int bestCost = c;
+						for (int j = 0; j < 8; ++j)
+						{
+							int nx = x + AstarGrid::NeighborX[j], ny = y + AstarGrid::NeighborY[j];
+							if (nx < 0 || width <= nx || ny < 0 || height <= ny)
+								continue;
+							int nc = cost[ny * width + nx] + ((j & 1) ? 11 : 8);
+							if (nc <= bestCost) // Unreachable + 11 never wins
+								best = j, bestCost = nc;
+						}
+					}
+					dirs[y * width + x] = (byte)best;
+				}
+			}
+		});
+	}
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PATHFINDER_FLOWFIELD_H
+#define PATHFINDER_FLOWFIELD_H
+
+#include "PathfinderAstar.h"
+
+/**
+ * Cost-to-goal and direction of every cell towards a single goal cell.
+ * Any number of units heading to the same goal can sample it in O(1)
+ */
+struct FlowField
+{
+	int   Goal;      // cell index of the goal, -1 if this field is unused
+	int*  Cost;      // integrated cost-to-goal of every cell, Unreachable if there is no path
+	byte* Dirs;      // AstarGrid::NeighborX/Y index [0..7] of the next cell towards the goal, NoDirection at the goal or if unreachable
+	uint  LastUsed;  // FlowFieldCache use counter of the last Get(), for LRU eviction
+	int   NumSettled;// number of cells reached by the last build
+
+	static const int  Unreachable = AstarGrid::Unreachable; // memset friendly
+	static const byte NoDirection = 0xff;
+
+	inline FlowField() : Goal(-1), Cost(0), Dirs(0), LastUsed(0), NumSettled(0) {}
+	inline ~FlowField() { destroy(); }
+	FlowField(const FlowField& other)          = delete; // NOCOPY
+	FlowField& operator=(const FlowField& rhs) = delete; // NOCOPY
+
+	void destroy();
+
+	/** @return TRUE if the goal can be reached from this cell */
+	inline bool reachable(int cell) const { return Cost[cell] != Unreachable; }
+
+	/** @return Next cell towards the goal, -1 at the goal or if the goal can't be reached */
+	inline int next(const AstarGrid& grid, int cell) const
+	{
+		int dir = Dirs[cell];
+		if (dir == NoDirection) return -1;
+		return cell + AstarGrid::NeighborY[dir] * grid.Width + AstarGrid::NeighborX[dir];
+	}
+
+	/** @return Normalized direction towards the goal, [0,0] at the goal or if unreachable */
+	Vector2 direction(int cell) const;
+};
+
+/**
+ * Builds and caches FlowFields over the AstarGrid of a PathfinderAstar.
+ * A field is built with a single Dial sweep from the goal (edge costs are only 8 or 11,
+ * so a ring of 12 buckets replaces the priority queue), then the directions are
+ * derived from the costs row by row on all worker threads.
+ * Listens to grid changes and drops every cached field that could reach a changed cell.
+ * @note Not thread safe, fields are built and evicted by Get()
+ */
+struct FlowFieldCache : public AstarGridListener
+{
+	PathfinderAstar* Finder;
+	FlowField* Fields;   // cached fields, Goal == -1 if the slot is free
+	int  NumFields;      // number of cache slots
+	uint UseCounter;     // incremented by every Get()
+	int  NumBuilds;      // total number of fields built, for statistics
+	PfVector<int> Buckets[12]; // Dial buckets: cells with cost % 12 == index
+
+	inline FlowFieldCache() : Finder(0), Fields(0), NumFields(0), UseCounter(0), NumBuilds(0) {}
+	inline ~FlowFieldCache() { Destroy(); }
+	FlowFieldCache(const FlowFieldCache& other)          = delete; // NOCOPY
+	FlowFieldCache& operator=(const FlowFieldCache& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Allocates the cache for the grid of the pathfinder and listens to its changes
+	 * @param maxFields Maximum number of goals kept in the cache; each takes 5 bytes per cell
+	 */
+	void Create(PathfinderAstar* finder, int maxFields = 8);
+	void Destroy();
+
+	/** @return Total number of bytes allocated by the cache */
+	size_t Bytes() const;
+
+	/**
+	 * @brief Returns the field of the goal cell, building it if it isn't cached.
+	 *        The least recently used field is evicted when the cache is full
+	 * @return NULL if the goal is outside of the grid or in the collision plane
+	 */
+	const FlowField* Get(int goal);
+	const FlowField* Get(int x, int y);
+
+	/** @return Cached field of the goal or NULL, never builds */
+	const FlowField* Find(int goal) const;
+
+	/** @brief Drops all cached fields */
+	void Clear();
+
+	// AstarGridListener
+	void OnGridChanged(int x, int y, int w, int h) override;
+
+	void build(FlowField& field, int goal);
+	void integrate(FlowField& field);
+	void build_directions(FlowField& field);
+};
+
+
+#endif // PATHFINDER_FLOWFIELD_H
@@ -0,0 +1,503 @@
+#include "PathfinderHPA.h"
+#include "AstarPolicies.h"
+
+
+	void HpaLocalSearch::run(const AstarGrid& grid, const HpaCluster& cluster, int src, int target)
+	{
+		const int width = cluster.Width;
+		const int count = width * cluster.Height;
+		if (count > Capacity)
+		{
+			if (States) free(States);
+			States   = (AstarState*)calloc(count, sizeof(AstarState));
+			Capacity = count;
+			OpenID   = 0;
+		}
+		if (++OpenID == AstarState::ClosedBit)
+		{
+			memset(States, 0, sizeof(AstarState) * Capacity);
+			OpenID = 1;
+		}
+		Cluster = &cluster;
+
+		const uint openID   = OpenID;
+		const uint closedID = openID | AstarState::ClosedBit;
+		const ushort* planes = grid.Planes;
+		AstarState* states = States;
+		int localTarget = target == -1 ? -1 : local(grid, target);
+
+		int head = local(grid, src);
+		AstarState* headState = &states[head];
+		headState->FScore = 0;
+		headState->GScore = 0;
+		headState->OpenID = closedID;
+		headState->Prev   = -1;
+
+		while (head != localTarget)
+		{
+			int hx = cluster.X + head % width;
+			int hy = cluster.Y + head / width;
+			int headGScore = headState->GScore;
+			for (int i = 0; i < 8; ++i)
+			{
+				int x = hx + AstarGrid::NeighborX[i], y = hy + AstarGrid::NeighborY[i];
+				if (!cluster.contains(x, y) || planes[y * grid.Width + x] == 1)
+					continue;
+
+				int index = (y - cluster.Y) * width + (x - cluster.X);
+				AstarState* s = &states[index];
+				const uint sid = s->OpenID;
+				if (sid == closedID)
+					continue;
+
+				int gscore = headGScore + ((i & 1) ? 11 : 8); // odd neighbors are diagonal
+				if (sid == openID)
+				{
+					if (gscore >= s->GScore)
+						continue;
+					s->FScore = s->GScore = gscore;
+					s->Prev   = head;
+					Open.repos(s);
+				}
+				else
+				{
+					s->FScore = s->GScore = gscore;
+					s->Prev   = head;
+					s->OpenID = openID;
+					Open.insert(s);
+				}
+			}
+
+			if (Open.empty())
+				break;
+
+			headState = Open.pop();
+			headState->OpenID = closedID;
+			head = int(headState - states);
+		}
+		Open.clear();
+	}
+
+	int HpaLocalSearch::cost(const AstarGrid& grid, int cell) const
+	{
+		if (!Cluster->contains(grid.x_of(cell), grid.y_of(cell)))
+			return -1;
+		const AstarState& s = States[local(grid, cell)];
+		return s.OpenID == (OpenID | AstarState::ClosedBit) ? s.GScore : -1;
+	}
+
+	int HpaLocalSearch::prev(const AstarGrid& grid, int cell) const
+	{
+		int p = States[local(grid, cell)].Prev;
+		if (p == -1)
+			return -1;
+		return grid.index(Cluster->X + p % Cluster->Width, Cluster->Y + p / Cluster->Width);
+	}
+
+
+
+
+	void PathfinderHPA::Create(PathfinderAstar* finder, int clusterSize)
+	{
+		Destroy();
+		const AstarGrid& grid = finder->Grid;
+		Finder      = finder;
+		Finder->AddListener(this);
+		ClusterSize = clusterSize;
+		ClustersX   = (grid.Width  + clusterSize - 1) / clusterSize;
+		ClustersY   = (grid.Height + clusterSize - 1) / clusterSize;
+		Clusters    = new HpaCluster[ClustersX * ClustersY];
+		for (int cy = 0; cy < ClustersY; ++cy)
+		{
+			for (int cx = 0; cx < ClustersX; ++cx)
+			{
+				HpaCluster& c = Clusters[cy * ClustersX + cx];
+				c.X = cx * clusterSize;
+				c.Y = cy * clusterSize;
+				c.Width  = grid.Width  - c.X < clusterSize ? grid.Width  - c.X : clusterSize;
+				c.Height = grid.Height - c.Y < clusterSize ? grid.Height - c.Y : clusterSize;
+			}
+		}
+
+		int count = grid.Width * grid.Height;
+		EntranceIndex = (int*)malloc(sizeof(int) * count);
+		memset(EntranceIndex, 0xff, sizeof(int) * count); // -1
+		NumDirty = ClustersX * ClustersY;
+		Context.create(grid, 1024);
+		Update();
+	}
+
+	void PathfinderHPA::Destroy()
+	{
+		if (Clusters)
+		{
+			delete[] Clusters;
+			Clusters = NULL;
+		}
+		if (EntranceIndex)
+		{
+			free(EntranceIndex);
+			EntranceIndex = NULL;
+		}
+		Context.destroy();
+		if (Finder)
+		{
+			Finder->RemoveListener(this);
+			Finder = NULL;
+		}
+		ClustersX = ClustersY = 0;
+		NumDirty  = 0;
+	}
+
+	size_t PathfinderHPA::Bytes() const
+	{
+		int numClusters = ClustersX * ClustersY;
+		size_t total = sizeof(HpaCluster) * numClusters;
+		for (int i = 0; i < numClusters; ++i)
+		{
+			total += sizeof(int) * Clusters[i].Entrances.capacity();
+			total += sizeof(int) * Clusters[i].Costs.capacity();
+		}
+		if (Finder)
+			total += sizeof(int) * Finder->Grid.Width * Finder->Grid.Height;
+		return total + Context.bytes();
+	}
+
+	int PathfinderHPA::NumEntrances() const
+	{
+		int total = 0;
+		for (int i = 0, numClusters = ClustersX * ClustersY; i < numClusters; ++i)
+			total += Clusters[i].Entrances.size();
+		return total;
+	}
+
+
+
+
+	void PathfinderHPA::MarkChanged(int x, int y, int w, int h)
+	{
+		// a cell within 1 of a cluster border also changes the transitions of the neighbor
+		const AstarGrid& grid = Finder->Grid;
+		int x0 = x - 1, y0 = y - 1, x1 = x + w, y1 = y + h;
+		if (x0 < 0) x0 = 0;
+		if (y0 < 0) y0 = 0;
+		if (x1 >= grid.Width)  x1 = grid.Width  - 1;
+		if (y1 >= grid.Height) y1 = grid.Height - 1;
+		if (x0 > x1 || y0 > y1)
+			return;
+
+		for (int cy = y0 / ClusterSize; cy <= y1 / ClusterSize; ++cy)
+		{
+			for (int cx = x0 / ClusterSize; cx <= x1 / ClusterSize; ++cx)
+			{
+				HpaCluster& c = Clusters[cy * ClustersX + cx];
+				if (!c.Dirty)
+				{
+					c.Dirty = true;
+					++NumDirty;
+				}
+			}
+		}
+	}
+
+	int PathfinderHPA::Update()
+	{
+		if (!NumDirty)
+			return 0;
+
+		int numRebuilt = 0;
+		for (int i = 0, numClusters = ClustersX * ClustersY; i < numClusters; ++i)
+		{
+			HpaCluster& c = Clusters[i];
+			if (c.Dirty)
+			{
+				rebuild_cluster(c);
+				c.Dirty = false;
+				++numRebuilt;
+			}
+		}
+		NumDirty = 0;
+
+		// every entrance is in the abstract open list at most once, plus the start and end cells
+		Context.Open.reserve(NumEntrances() + 2);
+		return numRebuilt;
+	}
+
+	void PathfinderHPA::add_entrance(HpaCluster& c, int cell)
+	{
+		if (EntranceIndex[cell] == -1)
+		{
+			EntranceIndex[cell] = c.Entrances.size();
+			c.Entrances.push_back(cell);
+		}
+	}
+
+	/**
+	 * Finds the transitions over the border between cells A(i) = [ox, oy] + i*[sx, sy]
+	 * and B(i) = A(i) + [cx, cy]. Both clusters of the border call this with the same
+	 * arguments, so they always agree on the transitions; sideB picks which side we keep.
+	 */
+	void PathfinderHPA::add_border(HpaCluster& c, int ox, int oy, int sx, int sy, int cx, int cy, int len, bool sideB)
+	{
+		const AstarGrid& grid = Finder->Grid;
+		const int cross = cy * grid.Width + cx; // cell offset from A to B
+		const int step  = sy * grid.Width + sx;
+		const int first = grid.index(ox, oy);
+		auto A = [&](int i) { return first + i * step; };
+		auto straight = [&](int i) { return grid.walkable(A(i)) && grid.walkable(A(i) + cross); };
+		auto add = [&](int a, int b) { add_entrance(c, sideB ? b : a); };
+
+		// maximal runs of straight crossings: one transition in the middle, or both ends if it's long
+		for (int i = 0; i < len; ++i)
+		{
+			if (!straight(i))
+				continue;
+			int j = i;
+			while (j + 1 < len && straight(j + 1))
+				++j;
+			if (j - i + 1 >= 6)
+			{
+				add(A(i), A(i) + cross);
+				add(A(j), A(j) + cross);
+			}
+			else
+			{
+				int mid = (i + j) / 2;
+				add(A(mid), A(mid) + cross);
+			}
+			i = j;
+		}
+
+		// diagonal crossings that aren't connected to any straight run along the border
+		for (int i = 0; i < len; ++i)
+		{
+			if (!grid.walkable(A(i)) || straight(i))
+				continue;
+			for (int k = i - 1; k <= i + 1; k += 2)
+			{
+				if (0 <= k && k < len && grid.walkable(A(k) + cross) && !straight(k))
+					add(A(i), A(k) + cross);
+			}
+		}
+	}
+
+	void PathfinderHPA::rebuild_cluster(HpaCluster& c)
+	{
+		const AstarGrid& grid = Finder->Grid;
+		for (int i = 0; i < c.Entrances.size(); ++i)
+			EntranceIndex[c.Entrances[i]] = -1;
+		c.Entrances.clear();
+		c.Costs.clear();
+
+		int x0 = c.X, y0 = c.Y;
+		int x1 = c.X + c.Width - 1, y1 = c.Y + c.Height - 1;
+		if (x1 + 1 < grid.Width)  add_border(c, x1,     y0,     0, 1, 1, 0, c.Height, false); // east
+		if (x0 > 0)               add_border(c, x0 - 1, y0,     0, 1, 1, 0, c.Height, true);  // west
+		if (y1 + 1 < grid.Height) add_border(c, x0,     y1,     1, 0, 0, 1, c.Width,  false); // north
+		if (y0 > 0)               add_border(c, x0,     y0 - 1, 1, 0, 0, 1, c.Width,  true);  // south
+
+		// corner to corner transitions with the diagonal neighbors
+		for (int i = 1; i < 8; i += 2)
+		{
+			int x = AstarGrid::NeighborX[i] > 0 ? x1 : x0;
+			int y = AstarGrid::NeighborY[i] > 0 ? y1 : y0;
+			int corner   = grid.index(x, y);
+			int diagonal = grid.index(x + AstarGrid::NeighborX[i], y + AstarGrid::NeighborY[i]);
+			if (diagonal != -1 && grid.walkable(corner) && grid.walkable(diagonal))
+				add_entrance(c, corner);
+		}
+
+		// intra-cluster costs between all entrances
+		const int n = c.Entrances.size();
+		for (int i = 0; i < n * n; ++i)
+			c.Costs.push_back(-1);
+		for (int i = 0; i < n; ++i)
+		{
+			LocalSearch.run(grid, c, c.Entrances[i]);
+			for (int j = 0; j < n; ++j)
+				c.Costs[i * n + j] = LocalSearch.cost(grid, c.Entrances[j]);
+		}
+	}
+
+
+
+
+	bool PathfinderHPA::FindPath(int start, int end, HpaPath& outPath)
+	{
+		outPath.clear();
+		if (NumDirty)
+			Update();
+
+		const AstarGrid& grid = Finder->Grid;
+		const uint openID   = Context.begin_search();
+		const uint closedID = openID | AstarState::ClosedBit;
+		if (grid.Planes[start] != grid.Planes[end] || grid.Planes[start] == 1)
+			return false; // no possible path between these two, or collision planes(1)
+
+		const int startCluster = cluster_of(start);
+		const int endCluster   = cluster_of(end);
+		StartSearch.run(grid, Clusters[startCluster], start);
+		EndSearch.run(grid, Clusters[endCluster], end);
+
+		AstarState* states = Context.States;
+		PfOpenList& openList = Context.Open;
+		int numOpened   = 0;
+		int numReopened = 0;
+		int numExpanded = 0;
+		int maxDepth    = Context.MaxDepth;
+		int goalX = grid.x_of(end);
+		int goalY = grid.y_of(end);
+
+		int head = start;
+		AstarState* headState = &states[start];
+		headState->FScore = 0;
+		headState->GScore = 0;
+		headState->OpenID = closedID;
+		headState->Prev   = -1;
+		int headGScore = 0;
+
+		auto open = [&](int index, int gain)
+		{
+			AstarState* s = &states[index];
+			const uint sid = s->OpenID;
+			if (sid == closedID)
+				return;
+
+			int gscore = headGScore + gain;
+			if (sid == openID)
+			{
+				if (gscore >= s->GScore)
+					return;
+				s->FScore += gscore - s->GScore;
+				s->GScore  = gscore;
+				s->Prev    = head;
+				++numOpened;
+				++numReopened;
+				openList.repos(s);
+			}
+			else
+			{
+				s->GScore = gscore;
+				s->FScore = gscore + octile(goalX - grid.x_of(index), goalY - grid.y_of(index));
+				s->Prev   = head;
+				s->OpenID = openID;
+				++numOpened;
+				openList.insert(s);
+			}
+			int size = openList.size();
+			if (size > maxDepth) maxDepth = size;
+		};
+
+		while (head != end)
+		{
+			headGScore = headState->GScore;
+			const int cluster = cluster_of(head);
+			const HpaCluster& c = Clusters[cluster];
+			const int entrance = EntranceIndex[head];
+			const int numEntrances = c.Entrances.size();
+
+			if (head == start) // temporary edges from the start to its own cluster
+			{
+				for (int j = 0; j < numEntrances; ++j)
+				{
+					int cost = StartSearch.cost(grid, c.Entrances[j]);
+					if (cost > 0) open(c.Entrances[j], cost);
+				}
+				if (cluster == endCluster)
+				{
+					int cost = StartSearch.cost(grid, end);
+					if (cost >= 0) open(end, cost);
+				}
+			}
+			else if (entrance != -1) // intra-cluster edges
+			{
+				for (int j = 0; j < numEntrances; ++j)
+				{
+					int cost = c.cost(entrance, j);
+					if (cost > 0) open(c.Entrances[j], cost);
+				}
+			}
+
+			if (entrance != -1)
+			{
+				// inter-cluster edges to the adjacent entrances of other clusters
+				int x = grid.x_of(head), y = grid.y_of(head);
+				for (int i = 0; i < 8; ++i)
+				{
+					int nx = x + AstarGrid::NeighborX[i], ny = y + AstarGrid::NeighborY[i];
+					int index = grid.index(nx, ny);
+					if (index != -1 && EntranceIndex[index] != -1 && !c.contains(nx, ny))
+						open(index, (i & 1) ? 11 : 8);
+				}
+
+				// temporary edge to the end inside its own cluster
+				if (cluster == endCluster && head != start)
+				{
+					int cost = EndSearch.cost(grid, head);
+					if (cost >= 0) open(end, cost);
+				}
+			}
+
+			if (openList.empty())
+				break;
+
+			headState = openList.pop();
+			headState->OpenID = closedID;
+			head = int(headState - states);
+			++numExpanded;
+		}
+
+		Context.NumOpened   = numOpened;
+		Context.NumReopened = numReopened;
+		Context.NumExpanded = numExpanded;
+		Context.MaxDepth    = maxDepth;
+		openList.clear();
+		if (head != end)
+			return false;
+
+		// abstract path is collected [end .. start], so reverse it
+		for (int index = end; index != -1; index = states[index].Prev)
+			outPath.Nodes.push_back(index);
+		for (int i = 0, j = outPath.Nodes.size() - 1; i < j; ++i, --j)
+		{
+			int tmp = outPath.Nodes[i];
+			outPath.Nodes[i] = outPath.Nodes[j];
+			outPath.Nodes[j] = tmp;
+		}
+		if (outPath.Nodes.size() == 1) // start == end
+			outPath.Nodes.push_back(end);
+		return true;
+	}
+
+	int PathfinderHPA::Refine(HpaPath& path, PfVector<Vector2>& outPath, int maxSegments)
+	{
+		const AstarGrid& grid = Finder->Grid;
+		const int numSegments = path.num_segments();
+		if (path.Refined == 0 && numSegments)
+			outPath.push_back(Finder->ToScreenCoordCentered(path.Nodes[0]));
+
+		int last = numSegments;
+		if (maxSegments > 0 && path.Refined + maxSegments < numSegments)
+			last = path.Refined + maxSegments;
+
+		for (; path.Refined < last; ++path.Refined)
+		{
+			int a = path.Nodes[path.Refined];
+			int b = path.Nodes[path.Refined + 1];
+			if (a == b)
+				continue;
+
+			int cluster = cluster_of(a);
+			if (cluster != cluster_of(b)) // inter-cluster edges are always a single step
+			{
+				outPath.push_back(Finder->ToScreenCoordCentered(b));
+				continue;
+			}
+
+			// search backwards from b, so following Prev from a gives the cells in order
+			LocalSearch.run(grid, Clusters[cluster], b, a);
+			for (int cell = LocalSearch.prev(grid, a); cell != -1; cell = LocalSearch.prev(grid, cell))
+				outPath.push_back(Finder->ToScreenCoordCentered(cell));
+		}
+		return numSegments - path.Refined;
+	}
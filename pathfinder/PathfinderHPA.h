@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PATHFINDER_HPA_H
+#define PATHFINDER_HPA_H
+
+#include "PathfinderAstar.h"
+
+/**
+ * A single NxN sector of the grid with its entrance cells
+ * and the intra-cluster path costs between all of its entrances
+ */
+struct HpaCluster
+{
+	int X, Y;           // lower-left cell of the cluster
+	int Width, Height;  // size of the cluster in cells; edge clusters can be smaller
+	PfVector<int> Entrances; // cell indices of the entrances of this cluster
+	PfVector<int> Costs;     // [i * numEntrances + j] cost from entrance i to j, -1 if unreachable inside the cluster
+	bool Dirty;         // cells of this cluster or its border changed, rebuild in Update()
+
+	inline HpaCluster() : X(0), Y(0), Width(0), Height(0), Dirty(true) {}
+
+	inline bool contains(int x, int y) const
+	{
+		return X <= x && x < X + Width && Y <= y && y < Y + Height;
+	}
+	inline int cost(int i, int j) const { return Costs[i * Entrances.size() + j]; }
+};
+
+/**
+ * Dijkstra restricted to the cells of a single cluster.
+ * Used for intra-cluster costs, connecting start/end to the abstract graph and for refinement
+ */
+struct HpaLocalSearch
+{
+	node_buckets Open;
+	AstarState*  States;  // local state of every cell in the cluster [(y - Y) * Width + (x - X)]
+	int  Capacity;        // number of allocated States
+	uint OpenID;          // unique ID of the current search, always < AstarState::ClosedBit
+	const HpaCluster* Cluster; // cluster of the last search
+
+	inline HpaLocalSearch() : States(0), Capacity(0), OpenID(0), Cluster(0) {}
+	inline ~HpaLocalSearch() { if (States) free(States); }
+	HpaLocalSearch(const HpaLocalSearch& other)          = delete; // NOCOPY
+	HpaLocalSearch& operator=(const HpaLocalSearch& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Runs Dijkstra from cell [src] inside the cluster
+	 * @param target Stops when this cell is reached, -1 to explore the whole cluster
+	 */
+	void run(const AstarGrid& grid, const HpaCluster& cluster, int src, int target = -1);
+
+	/** @return Cost from the source to the cell, -1 if it wasn't reached */
+	int cost(const AstarGrid& grid, int cell) const;
+
+	/** @return Previous cell on the path from the source to the cell, -1 at the source */
+	int prev(const AstarGrid& grid, int cell) const;
+
+	inline int local(const AstarGrid& grid, int cell) const
+	{
+		return (grid.y_of(cell) - Cluster->Y) * Cluster->Width + (grid.x_of(cell) - Cluster->X);
+	}
+};
+
+/**
+ * An abstract path that is refined into grid cells on demand
+ */
+struct HpaPath
+{
+	PfVector<int> Nodes; // abstract path cells [start .. end]
+	int Refined;         // number of abstract segments already refined
+
+	inline HpaPath() : Refined(0) {}
+	inline int num_segments() const { return Nodes.size() ? Nodes.size() - 1 : 0; }
+	inline bool refined() const { return Refined >= num_segments(); }
+	inline void clear() { Nodes.clear(), Refined = 0; }
+};
+
+/**
+ * HPA* hierarchy over the AstarGrid of a PathfinderAstar.
+ * The grid is split into NxN clusters. Every maximal run of crossable cells on a cluster
+ * border gets 1 or 2 transitions, isolated diagonal crossings and cluster corners get
+ * their own transitions. Long queries are searched on the small abstract graph of these
+ * entrances and only refined into grid cells segment by segment.
+ * @note Not thread safe, a single search context is shared by all queries
+ */
+struct PathfinderHPA : public AstarGridListener
+{
+	PathfinderAstar* Finder;
+	HpaCluster* Clusters;
+	int ClusterSize;     // cluster width and height in cells
+	int ClustersX;       // number of clusters along X
+	int ClustersY;       // number of clusters along Y
+	int* EntranceIndex;  // per cell index into its cluster Entrances, -1 if not an entrance
+	int NumDirty;        // number of clusters waiting for Update()
+
+	SearchContext  Context;     // abstract search state, indexed by cell like the grid
+	HpaLocalSearch StartSearch; // start cell costs to the entrances of its cluster
+	HpaLocalSearch EndSearch;   // end cell costs to the entrances of its cluster
+	HpaLocalSearch LocalSearch; // cluster rebuilds and refinement
+
+	inline PathfinderHPA()
+		: Finder(0), Clusters(0), ClusterSize(0), ClustersX(0), ClustersY(0), EntranceIndex(0), NumDirty(0)
+	{
+	}
+	inline ~PathfinderHPA() { Destroy(); }
+	PathfinderHPA(const PathfinderHPA& other)          = delete; // NOCOPY
+	PathfinderHPA& operator=(const PathfinderHPA& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Builds the cluster hierarchy over the current grid of the pathfinder.
+	 *        Registers as a grid listener, so PathfinderAstar::SetBlocked() marks the changed clusters
+	 * @param clusterSize Width and height of a single cluster in cells
+	 */
+	void Create(PathfinderAstar* finder, int clusterSize = 16);
+	void Destroy();
+
+	/** @return Total number of bytes allocated by the hierarchy */
+	size_t Bytes() const;
+
+	/** @return Total number of entrance nodes in the abstract graph */
+	int NumEntrances() const;
+
+	/**
+	 * @brief Marks all clusters affected by changed cells in [x, y, x+w, y+h) for rebuilding.
+	 *        Neighboring clusters are included when the change touches their border
+	 */
+	void MarkChanged(int x, int y, int w = 1, int h = 1);
+
+	// AstarGridListener
+	void OnGridChanged(int x, int y, int w, int h) override { MarkChanged(x, y, w, h); }
+
+	/**
+	 * @brief Rebuilds the entrances and intra-cluster costs of all marked clusters
+	 * @return Number of clusters rebuilt
+	 */
+	int Update();
+
+	/**
+	 * @brief Finds an abstract path from start to end. Call Refine() to get the actual cells
+	 * @param start Cell index of the start
+	 * @param end Cell index of the end
+	 * @return TRUE if a path exists
+	 */
+	bool FindPath(int start, int end, HpaPath& outPath);
+
+	/**
+	 * @brief Refines the next abstract segments of the path into grid cells
+	 * @param outPath Receives the refined cells in [start .. end] order, appended
+	 *                after the previous Refine() calls, so units can already start moving
+	 * @param maxSegments Maximum number of abstract segments to refine, <= 0 for all
+	 * @return Number of segments still unrefined
+	 */
+	int Refine(HpaPath& path, PfVector<Vector2>& outPath, int maxSegments = 1);
+
+	inline int cluster_of(int cell) const
+	{
+		const AstarGrid& grid = Finder->Grid;
+		return (grid.y_of(cell) / ClusterSize) * ClustersX + grid.x_of(cell) / ClusterSize;
+	}
+
+	void rebuild_cluster(HpaCluster& c);
+	void add_border(HpaCluster& c, int ox, int oy, int sx, int sy, int cx, int cy, int len, bool sideB);
+	void add_entrance(HpaCluster& c, int cell);
+};
+
+
+#endif // PATHFINDER_HPA_H
@@ -0,0 +1,313 @@
+/**
+ * Jump Point Search and JPS+ for uniform-cost 8-connected grids
+ * Harabor & Grastien 2011, with diagonal corner cutting allowed like AstarGrid links
+ */
+#include "PathfinderAstar.h"
+#include "AstarPolicies.h"
+
+
+	/**
+	 * Walkability lookups and the jump function over AstarGrid::Planes
+	 * @note Cells outside of the grid are treated as collision cells
+	 */
+	struct JpsGrid
+	{
+		const ushort* Planes;
+		int Width, Height;
+		int GoalX, GoalY;
+
+		inline JpsGrid(const AstarGrid& grid, int goal) 
+			: Planes(grid.Planes), Width(grid.Width), Height(grid.Height),
+			  GoalX(grid.x_of(goal)), GoalY(grid.y_of(goal))
+		{
+		}
+
+		__forceinline bool free(int x, int y) const
+		{
+			return unsigned(x) < unsigned(Width) && unsigned(y) < unsigned(Height) 
+				&& Planes[y * Width + x] != 1;
+		}
+
+		/**
+		 * @brief Moves from [x, y] in direction [dx, dy] until a jump point is found
+		 * @return Number of steps to the jump point, or 0 if we hit a wall
+		 */
+		int jump(int x, int y, int dx, int dy) const
+		{
+			for (int steps = 1; ; ++steps)
+			{
+				x += dx, y += dy;
+				if (!free(x, y))
+					return 0;
+				if (x == GoalX && y == GoalY)
+					return steps;
+
+				if (dx && dy) // diagonal
+				{
+					if ((free(x - dx, y + dy) && !free(x - dx, y)) || // forced neighbors
+						(free(x + dx, y - dy) && !free(x, y - dy)))
+						return steps;
+					if (jump(x, y, dx, 0) || jump(x, y, 0, dy)) // straight jump points
+						return steps;
+				}
+				else if (dx) // horizontal
+				{
+					if ((free(x + dx, y + 1) && !free(x, y + 1)) ||
+						(free(x + dx, y - 1) && !free(x, y - 1)))
+						return steps;
+				}
+				else // vertical
+				{
+					if ((free(x + 1, y + dy) && !free(x + 1, y)) ||
+						(free(x - 1, y + dy) && !free(x - 1, y)))
+						return steps;
+				}
+			}
+		}
+
+		/**
+		 * @brief Collects the pruned search directions of a node reached in direction [dx, dy]
+		 * @return Number of directions written to dirs
+		 */
+		int directions(int x, int y, int dx, int dy, int (*dirs)[2]) const
+		{
+			int n = 0;
+			auto add = [&](int ddx, int ddy) { dirs[n][0] = ddx, dirs[n][1] = ddy, ++n; };
+			if (!dx && !dy) // start node, all directions are open
+			{
+				add(0, 1), add(1, 1), add(1, 0), add(1, -1);
+				add(0, -1), add(-1, -1), add(-1, 0), add(-1, 1);
+			}
+			else if (dx && dy) // diagonal: 3 natural + 2 forced
+			{
+				add(dx, 0), add(0, dy), add(dx, dy);
+				if (!free(x - dx, y) && free(x - dx, y + dy)) add(-dx, dy);
+				if (!free(x, y - dy) && free(x + dx, y - dy)) add(dx, -dy);
+			}
+			else if (dx) // horizontal: 1 natural + 2 forced
+			{
+				add(dx, 0);
+				if (!free(x, y + 1) && free(x + dx, y + 1)) add(dx, 1);
+				if (!free(x, y - 1) && free(x + dx, y - 1)) add(dx, -1);
+			}
+			else // vertical: 1 natural + 2 forced
+			{
+				add(0, dy);
+				if (!free(x + 1, y) && free(x + 1, y + dy)) add(1, dy);
+				if (!free(x - 1, y) && free(x - 1, y + dy)) add(-1, dy);
+			}
+			return n;
+		}
+	};
+
+	static __forceinline int sign(int v) { return (v > 0) - (v < 0); }
+
+
+	/**
+	 * Online JPS: scans the grid cell by cell to find the next jump point
+	 */
+	struct OnlineJumps
+	{
+		const JpsGrid& Grid;
+
+		inline OnlineJumps(const JpsGrid& grid) : Grid(grid) {}
+
+		// @return Number of steps to the next jump point in direction [dx, dy], 0 if there is none
+		__forceinline int jump(int /*cell*/, int x, int y, int dx, int dy) const
+		{
+			return Grid.jump(x, y, dx, dy);
+		}
+	};
+
+	/**
+	 * JPS+: looks up the next jump point from the precomputed JpsPlusTable.
+	 * The goal isn't known during precompute, so it's checked here instead
+	 */
+	struct TableJumps
+	{
+		const JpsGrid& Grid;
+		const JpsPlusTable& Table;
+
+		inline TableJumps(const JpsGrid& grid, const JpsPlusTable& table) : Grid(grid), Table(table) {}
+
+		// @return Number of steps to the next jump point in direction [dx, dy], 0 if there is none
+		__forceinline int jump(int cell, int x, int y, int dx, int dy) const
+		{
+			int dist  = Table.get(cell)[JpsPlusTable::dir_index(dx, dy)];
+			int reach = dist > 0 ? dist : -dist; // number of free steps we can take
+			int gx = (Grid.GoalX - x) * dx; // steps to goal along each axis, <= 0 if the goal is behind us
+			int gy = (Grid.GoalY - y) * dy;
+			if (dx && dy)
+			{
+				// goal is somewhere ahead of this diagonal: stop where we line up with the goal
+				int steps = gx < gy ? gx : gy;
+				if (steps > 0 && steps <= reach)
+					return steps;
+			}
+			else if (dx) 
+			{
+				if (Grid.GoalY == y && gx > 0 && gx <= reach)
+					return gx;
+			}
+			else if (Grid.GoalX == x && gy > 0 && gy <= reach)
+				return gy;
+			return dist > 0 ? dist : 0;
+		}
+	};
+
+
+	/**
+	 * A* over jump points. Jumps decides how far we can jump from a node in a given direction
+	 */
+	template<class Jumps, class OpenListType> 
+	static bool JumpSearch(const PathfinderAstar& pf, const Jumps& jumps, SearchContextT<OpenListType>& ctx, 
+	                       int start, int end, PfVector<Vector2>& outPath, PfVector<Vector2>* explored)
+	{
+		const uint openID   = ctx.OpenID;
+		const uint closedID = openID | AstarState::ClosedBit;
+		const AstarGrid& grid = pf.Grid;
+		const JpsGrid& jgrid  = jumps.Grid;
+		const int width = grid.Width;
+		AstarState* states = ctx.States;
+		OpenListType& openList = ctx.Open;
+		int numOpened   = 0;
+		int numReopened = 0;
+		int numExpanded = 0;
+		int maxDepth    = ctx.MaxDepth;
+
+		int head = start;
+		AstarState* headState = &states[start];
+		headState->FScore = 0;
+		headState->GScore = 0;
+		headState->OpenID = closedID;
+		headState->Prev   = -1;
+
+		int dirs[8][2];
+		while (head != end)
+		{
+			int x = head % width, y = head / width;
+			int dx = 0, dy = 0; // direction we arrived from
+			if (headState->Prev != -1)
+			{
+				dx = sign(x - grid.x_of(headState->Prev));
+				dy = sign(y - grid.y_of(headState->Prev));
+			}
+			const int headGScore = headState->GScore;
+
+			for (int i = 0, count = jgrid.directions(x, y, dx, dy, dirs); i < count; ++i)
+			{
+				int ddx = dirs[i][0], ddy = dirs[i][1];
+				int steps = jumps.jump(head, x, y, ddx, ddy);
+				if (!steps)
+					continue; // ran into a wall
+
+				int jx = x + ddx * steps, jy = y + ddy * steps;
+				int index = jy * width + jx;
+				AstarState* s = &states[index];
+				const uint sid = s->OpenID;
+				if (sid == closedID)
+					continue;
+
+				int gscore = headGScore + steps * (ddx && ddy ? 11 : 8);
+				if (sid == openID) // we have opened this jump point before
+				{
+					if (gscore >= s->GScore)
+						continue;
+					s->FScore += gscore - s->GScore;
+					s->GScore  = gscore;
+					s->Prev    = head;
+					++numOpened;
+					++numReopened;
+					openList.repos(s);
+				}
+				else
+				{
+					s->GScore = gscore;
+					s->FScore = gscore + octile(jgrid.GoalX - jx, jgrid.GoalY - jy);
+					s->Prev   = head;
+					s->OpenID = openID;
+					++numOpened;
+					openList.insert(s);
+				}
+
+				int size = openList.size();
+				if (size > maxDepth) maxDepth = size;
+
+				if (explored)
+				{
+					explored->push_back(pf.ToScreenCoordCentered(head));
+					explored->push_back(pf.ToScreenCoordCentered(index));
+				}
+			}
+
+			if (openList.empty())
+				break;
+
+			headState = openList.pop();
+			headState->OpenID = closedID;
+			head = int(headState - states);
+			++numExpanded;
+		}
+
+		ctx.NumOpened   = numOpened;
+		ctx.NumReopened = numReopened;
+		ctx.NumExpanded = numExpanded;
+		ctx.MaxDepth    = maxDepth;
+		openList.clear();
+		if (head != end)
+			return false;
+
+		// construct the out path, filling in every cell between the jump points
+		int index = end;
+		int x = grid.x_of(end), y = grid.y_of(end);
+		outPath.push_back(pf.ToScreenCoordCentered(index));
+		while ((index = states[index].Prev) != -1)
+		{
+			int px = grid.x_of(index), py = grid.y_of(index);
+			int dx = sign(px - x), dy = sign(py - y);
+			while (x != px || y != py)
+			{
+				x += dx, y += dy;
+				outPath.push_back(pf.ToScreenCoordCentered(y * width + x));
+			}
+		}
+		return true;
+	}
+
+
+	template<class OpenListType> 
+	bool PathfinderAstar::ProcessJPS(SearchContextT<OpenListType>& ctx, int start, int end,
+	                                 PfVector<Vector2>& outPath, PfVector<Vector2>* explored) const
+	{
+		ctx.begin_search();
+		if (Grid.Planes[start] != Grid.Planes[end] || Grid.Planes[start] == 1)
+			return false; // no possible path between these two, or collision planes(1)
+
+		JpsGrid grid(Grid, end);
+		return JumpSearch(*this, OnlineJumps(grid), ctx, start, end, outPath, explored);
+	}
+
+	template<class OpenListType> 
+	bool PathfinderAstar::ProcessJPSPlus(SearchContextT<OpenListType>& ctx, int start, int end,
+	                                     PfVector<Vector2>& outPath, PfVector<Vector2>* explored) const
+	{
+		if (!JumpTable.Dist || JumpTable.Width != Grid.Width || JumpTable.Height != Grid.Height)
+			return ProcessJPS(ctx, start, end, outPath, explored); // no table for this grid
+
+		ctx.begin_search();
+		if (Grid.Planes[start] != Grid.Planes[end] || Grid.Planes[start] == 1)
+			return false; // no possible path between these two, or collision planes(1)
+
+		JpsGrid grid(Grid, end);
+		return JumpSearch(*this, TableJumps(grid, JumpTable), ctx, start, end, outPath, explored);
+	}
+
+	template bool PathfinderAstar::ProcessJPS(SearchContextT<node_heap>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessJPS(SearchContextT<node_vect>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessJPS(SearchContextT<node_iheap>&,   int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessJPS(SearchContextT<node_buckets>&, int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+
+	template bool PathfinderAstar::ProcessJPSPlus(SearchContextT<node_heap>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessJPSPlus(SearchContextT<node_vect>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessJPSPlus(SearchContextT<node_iheap>&,   int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessJPSPlus(SearchContextT<node_buckets>&, int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
@@ -0,0 +1,85 @@
+/**
+ * Path post-processing: collinear collapse, string pulling and compact grid coordinates
+ */
+#include "PathfinderAstar.h"
+
+
+	// screen coordinates of arbitrary cell sizes don't compare exactly, so the waypoints are compared as cells
+	static __forceinline Vector2i CellOf(const PathfinderAstar& pf, const Vector2& pos)
+	{
+		return Vector2i(int(pos.x / pf.CellSize), int(pos.y / pf.CellSize));
+	}
+
+
+	// keeps only the waypoints where the step direction changes
+	static int CollapseCollinear(const PathfinderAstar& pf, Vector2* path, int count)
+	{
+		if (count <= 2)
+			return count;
+		int kept = 1; // the first waypoint is always kept
+		Vector2i cur = CellOf(pf, path[1]);
+		Vector2i dir(cur.x - CellOf(pf, path[0]).x, cur.y - CellOf(pf, path[0]).y);
+		for (int i = 2; i < count; ++i)
+		{
+			Vector2i next = CellOf(pf, path[i]);
+			int dx = next.x - cur.x, dy = next.y - cur.y;
+			if (dx != dir.x || dy != dir.y) // [i-1] is a turn
+			{
+				path[kept++] = path[i - 1];
+				dir.x = dx, dir.y = dy;
+			}
+			cur = next;
+		}
+		path[kept++] = path[count - 1];
+		return kept;
+	}
+
+
+	// skips every waypoint that the previous kept waypoint can see past
+	static int StringPull(const PathfinderAstar& pf, Vector2* path, int count)
+	{
+		if (count <= 2)
+			return count;
+		const CollisionMask& mask = pf.LosMask;
+		int kept = 1;
+		Vector2i anchor = CellOf(pf, path[0]);
+		for (int i = 1; i < count - 1; ++i)
+		{
+			Vector2i next = CellOf(pf, path[i + 1]);
+			if (!mask.line_of_sight(anchor.x, anchor.y, next.x, next.y))
+			{
+				path[kept++] = path[i];
+				anchor = CellOf(pf, path[i]);
+			}
+		}
+		path[kept++] = path[count - 1];
+		return kept;
+	}
+
+
+	void PathfinderAstar::PostProcess(PfVector<Vector2>& path, PathPostProcess mode) const
+	{
+		if (mode == PATH_POST_NONE)
+			return;
+		int count = CollapseCollinear(*this, path.Data, path.size());
+		if (mode == PATH_POST_STRINGPULL)
+			count = StringPull(*this, path.Data, count);
+		path.Size = count;
+	}
+
+
+	void PathfinderAstar::ToVirtualPath(const PfVector<Vector2>& path, PfVector<Vector2i>& outPath) const
+	{
+		for (const Vector2& pos : path)
+			outPath.push_back(CellOf(*this, pos));
+	}
+
+	void PathfinderAstar::ToVirtualPath(const PfVector<Vector2>& path, PfVector<PathPoint16>& outPath) const
+	{
+		for (const Vector2& pos : path)
+		{
+			Vector2i cell = CellOf(*this, pos);
+			PathPoint16 point = { ushort(cell.x), ushort(cell.y) };
+			outPath.push_back(point);
+		}
+	}
@@ -0,0 +1,122 @@
+/**
+ * Bounded-cost reachability queries, such as the movement range of a unit
+ */
+#include "AstarPolicies.h"
+
+
+	/**
+	 * Dijkstra from the start: nodes are closed in cost order until the open list runs out.
+	 * Links past maxCost are never opened, so the search ends right at the cost bound
+	 */
+	template<class Neighbors, class OpenListType>
+	static int ReachableExpand(const PathfinderAstar& pf, SearchContextT<OpenListType>& ctx, const Neighbors& neighbors,
+	                           int start, int maxCost, PfVector<ReachableCell>& outCells)
+	{
+		const ushort* planes = pf.Grid.Planes;
+		AstarState* states   = ctx.States;
+		OpenListType& openList = ctx.Open;
+		const uint openID   = ctx.OpenID;
+		const uint closedID = openID | AstarState::ClosedBit;
+		int numOpened   = 0;
+		int numReopened = 0;
+		int numExpanded = 0;
+		int maxDepth    = ctx.MaxDepth;
+
+		AstarBegin(ctx, start);
+		int head       = start;
+		int headGScore = 0;
+
+		auto open = [&](int index, int /*x*/, int /*y*/, int gain)
+		{
+			if (planes[index] == 1)
+				return; // collision plane
+
+			int gscore = headGScore + gain;
+			if (gscore > maxCost)
+				return; // out of range
+
+			AstarState* s = &states[index];
+			const uint sid = s->OpenID;
+			if (sid == closedID)
+				return; // its cost is final
+
+			if (sid == openID)
+			{
+				if (gscore >= s->GScore)
+					return;
+				s->GScore = gscore; // no heuristic, FScore is the cost
+				s->FScore = gscore;
+				s->Prev   = head;
+				++numOpened;
+				++numReopened;
+				openList.repos(s);
+			}
+			else
+			{
+				s->GScore = gscore;
+				s->FScore = gscore;
+				s->Prev   = head;
+				s->OpenID = openID;
+				++numOpened;
+				openList.insert(s);
+			}
+
+			int size = openList.size();
+			if (size > maxDepth) maxDepth = size;
+		};
+
+		int count = 0;
+		for (;;)
+		{
+			ReachableCell cell = { head, headGScore };
+			outCells.push_back(cell);
+			++count;
+
+			neighbors.for_each(head, open);
+			if (openList.empty())
+				break;
+
+			AstarState* headState = openList.pop();
+			headState->OpenID = closedID;
+			head       = int(headState - states);
+			headGScore = headState->GScore;
+			++numExpanded;
+		}
+
+		ctx.NumOpened   += numOpened;
+		ctx.NumReopened += numReopened;
+		ctx.NumExpanded += numExpanded;
+		ctx.MaxDepth     = maxDepth;
+		openList.clear();
+		return count;
+	}
+
+	template<class Neighbors, class OpenListType>
+	static int ReachableSized(const PathfinderAstar& pf, SearchContextT<OpenListType>& ctx, int start, int maxCost,
+	                          PfVector<ReachableCell>& outCells, int agentSize)
+	{
+		if (agentSize > 1)
+			return ReachableExpand(pf, ctx, ClearanceNeighbors<Neighbors>(pf.Grid, agentSize), start, maxCost, outCells);
+		return ReachableExpand(pf, ctx, Neighbors(pf.Grid), start, maxCost, outCells);
+	}
+
+	template<class OpenListType>
+	int PathfinderAstar::ReachableWithin(SearchContextT<OpenListType>& ctx, int start, int maxCost,
+	                                     PfVector<ReachableCell>& outCells, int agentSize) const
+	{
+		ctx.begin_search();
+		if (start == -1 || maxCost < 0 || !Grid.fits(start, agentSize))
+			return 0;
+
+		// the links already include the terrain costs
+		if (Grid.Mode == GRID_LINKED)
+			return ReachableSized<LinkedNeighbors<Connect8>>(*this, ctx, start, maxCost, outCells, agentSize);
+		if (Grid.Costs)
+			return ReachableSized<ImplicitNeighbors<TerrainCost, Connect8>>(*this, ctx, start, maxCost, outCells, agentSize);
+		return ReachableSized<ImplicitNeighbors<UniformCost, Connect8>>(*this, ctx, start, maxCost, outCells, agentSize);
+	}
+
+	template int PathfinderAstar::ReachableWithin(SearchContextT<node_heap>&,    int, int, PfVector<ReachableCell>&, int) const;
+	template int PathfinderAstar::ReachableWithin(SearchContextT<node_vect>&,    int, int, PfVector<ReachableCell>&, int) const;
+	template int PathfinderAstar::ReachableWithin(SearchContextT<node_iheap>&,   int, int, PfVector<ReachableCell>&, int) const;
+	template int PathfinderAstar::ReachableWithin(SearchContextT<node_buckets>&, int, int, PfVector<ReachableCell>&, int) const;
@@ -0,0 +1,294 @@
+#include "PathfinderService.h"
+#include <algorithm>
+
+
+	// heap order of the Queue: TRUE if job a runs after job b
+	static bool runs_later(const PathService::Job* a, const PathService::Job* b)
+	{
+		if (a->Priority != b->Priority) return a->Priority < b->Priority;
+		if (a->Deadline != b->Deadline) return a->Deadline > b->Deadline;
+		return a->Sequence > b->Sequence;
+	}
+
+	// latest deadline of all tickets of the job
+	static PathService::Clock::time_point last_deadline(const PathService::Job* job)
+	{
+		return PathService::Clock::time_point(PathService::Clock::duration(job->LastDeadline.load()));
+	}
+
+	void PathService::Create(const PathfinderAstar* finder, int numWorkers)
+	{
+		Destroy();
+		if (numWorkers <= 0)
+			numWorkers = int(std::thread::hardware_concurrency()) - 1;
+		if (numWorkers < 1)
+			numWorkers = 1;
+
+		Finder = finder;
+		Quit   = false;
+		for (int i = 0; i < numWorkers; ++i)
+			Threads.emplace_back(&PathService::worker_main, this);
+	}
+
+	void PathService::Destroy()
+	{
+		if (!Threads.empty())
+		{
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				Quit = true;
+			}
+			WakeCond.notify_all();
+			for (std::thread& t : Threads)
+				t.join();
+			Threads.clear();
+		}
+
+		for (Job* job : Queue) delete job; // running jobs were finished by their workers
+		for (PathCompletion* c : Done)  delete c;
+		for (PathCompletion* c : Spare) delete c;
+		Queue.clear();
+		Pending.clear();
+		Tickets.clear();
+		Done.clear();
+		Spare.clear();
+		Finder = NULL;
+	}
+
+	uint PathService::Request(const PathRequest& req, int priority, float maxLatency)
+	{
+		const AstarGrid& grid = Finder->Grid;
+		int start = grid.index(req.Start.x, req.Start.y);
+		int end   = grid.index(req.End.x,   req.End.y);
+		Clock::time_point deadline = maxLatency > 0.0f
+			? Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(maxLatency))
+			: Clock::time_point::max();
+
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (++NextTicket == 0) // 0 is never a valid ticket
+			++NextTicket;
+		uint ticket = NextTicket;
+		++NumRequested;
+
+		if (start == -1 || end == -1) // nothing to search, deliver on the next Poll()
+		{
+			Done.push_back(new_completion(ticket, PATH_INVALID));
+			return ticket;
+		}
+
+		__int64 key = (((__int64)start * 3 + req.Post) << 32) | uint(end);
+		auto it = Pending.find(key);
+		if (it != Pending.end()) // identical request in flight, share its result
+		{
+			Job* job = it->second;
+			job->Tickets.push_back(ticket);
+			job->Deadlines.push_back(deadline);
+			if (deadline > last_deadline(job)) // a running search sees it at its next slice
+				job->LastDeadline = deadline.time_since_epoch().count();
+			Tickets[ticket] = job;
+			++NumShared;
+			if (!job->Running && (priority > job->Priority || deadline < job->Deadline))
+			{
+				if (priority > job->Priority) job->Priority = priority;
+				if (deadline < job->Deadline) job->Deadline = deadline;
+				std::make_heap(Queue.begin(), Queue.end(), runs_later);
+			}
+			return ticket;
+		}
+
+		Job* job = new Job();
+		job->Request  = req;
+		job->Start    = start;
+		job->End      = end;
+		job->Key      = key;
+		job->Priority = priority;
+		job->Sequence = NextSequence++;
+		job->Deadline = deadline;
+		job->LastDeadline = deadline.time_since_epoch().count();
+		job->Running  = false;
+		job->Canceled = false;
+		job->Tickets.push_back(ticket);
+		job->Deadlines.push_back(deadline);
+		Pending[key]    = job;
+		Tickets[ticket] = job;
+		Queue.push_back(job);
+		std::push_heap(Queue.begin(), Queue.end(), runs_later);
+		WakeCond.notify_one();
+		return ticket;
+	}
+
+	bool PathService::Cancel(uint ticket)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		auto it = Tickets.find(ticket);
+		if (it == Tickets.end()) // maybe it's done, but not delivered yet
+		{
+			for (auto c = Done.begin(); c != Done.end(); ++c)
+			{
+				if ((*c)->Ticket == ticket)
+				{
+					Spare.push_back(*c);
+					Done.erase(c);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		Job* job = it->second;
+		Tickets.erase(it);
+		for (int i = 0; i < job->Tickets.size(); ++i)
+		{
+			if (job->Tickets[i] == ticket)
+			{
+				job->Tickets.erase(i);
+				job->Deadlines.erase(i); // the job keeps searching until its LastDeadline
+				break;
+			}
+		}
+		if (job->Tickets.empty()) // nobody is waiting for it anymore
+		{
+			Pending.erase(job->Key);
+			job->Canceled = true; // a queued job is dropped when it's popped, a running one within a slice
+		}
+		return true;
+	}
+
+	int PathService::Poll(PathCompletion* out, int maxCount)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		int count = int(Done.size()) < maxCount ? int(Done.size()) : maxCount;
+		for (int i = 0; i < count; ++i)
+		{
+			PathCompletion* c = Done[i];
+			PathResult& result = out[i].Result;
+			out[i].Ticket      = c->Ticket;
+			result.Status      = c->Result.Status;
+			result.NumOpened   = c->Result.NumOpened;
+			result.NumReopened = c->Result.NumReopened;
+			result.MaxDepth    = c->Result.MaxDepth;
+			result.Path.swap(c->Result.Path);
+			Spare.push_back(c);
+		}
+		Done.erase(Done.begin(), Done.begin() + count);
+		return count;
+	}
+
+	int PathService::NumPending()
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		return int(Tickets.size() + Done.size());
+	}
+
+	void PathService::worker_main()
+	{
+		PathSearch search; // search state of this worker, allocated by the first search
+		std::unique_lock<std::mutex> lock(Mutex);
+		for (;;)
+		{
+			WakeCond.wait(lock, [this]() { return Quit || !Queue.empty(); });
+			if (Quit)
+				return;
+
+			std::pop_heap(Queue.begin(), Queue.end(), runs_later);
+			Job* job = Queue.back();
+			Queue.pop_back();
+			if (job->Canceled)
+			{
+				delete job;
+				continue;
+			}
+			job->Running = true;
+			lock.unlock();
+
+			PathStatus status = PATH_TIMEOUT;
+			if (Clock::now() < last_deadline(job)) // don't bother if every ticket is already late
+			{
+				SearchStatus s = Finder->BeginSearch(search, job->Start, job->End);
+				while (s == SEARCH_IN_PROGRESS && !job->Canceled && Clock::now() < last_deadline(job))
+					s = Finder->Step(search, SliceExpansions);
+
+				if (s == SEARCH_IN_PROGRESS)
+					Finder->Cancel(search);
+				else if (s == SEARCH_FOUND)
+				{
+					status = PATH_FOUND;
+					if (job->Request.Post != PATH_POST_NONE)
+						Finder->PostProcess(search.Path, job->Request.Post);
+				}
+				else
+					status = PATH_UNREACHABLE;
+			}
+
+			lock.lock();
+			complete(job, status, status == PATH_TIMEOUT ? NULL : &search);
+		}
+	}
+
+	void PathService::complete(Job* job, PathStatus status, const PathSearch* search)
+	{
+		if (!job->Canceled)
+		{
+			const Clock::time_point now = Clock::now();
+			int numWaiting = 0; // tickets that joined after the search gave up, but still have time
+			for (int i = 0; i < job->Tickets.size(); ++i)
+			{
+				uint ticket = job->Tickets[i];
+				Clock::time_point deadline = job->Deadlines[i];
+				if (status == PATH_TIMEOUT && now < deadline)
+				{
+					job->Tickets[numWaiting]   = ticket;
+					job->Deadlines[numWaiting] = deadline;
+					++numWaiting;
+					continue;
+				}
+
+				// a shared search can finish after the deadline of some of its tickets
+				PathCompletion* c = new_completion(ticket, now < deadline ? status : PATH_TIMEOUT);
+				if (c->Result.Status != PATH_TIMEOUT)
+				{
+					PathResult& result = c->Result;
+					for (const Vector2& point : search->Path)
+						result.Path.push_back(point);
+					result.NumOpened   = search->Context.NumOpened;
+					result.NumReopened = search->Context.NumReopened;
+					result.MaxDepth    = search->Context.MaxDepth;
+				}
+				else
+					++NumTimedOut;
+				Tickets.erase(ticket);
+				Done.push_back(c);
+			}
+
+			if (numWaiting)
+			{
+				job->Tickets.Size   = numWaiting;
+				job->Deadlines.Size = numWaiting;
+				job->Deadline = *std::min_element(job->Deadlines.begin(), job->Deadlines.end());
+				job->LastDeadline = std::max_element(job->Deadlines.begin(), job->Deadlines.end())->time_since_epoch().count();
+				job->Running  = false;
+				Queue.push_back(job);
+				std::push_heap(Queue.begin(), Queue.end(), runs_later);
+				WakeCond.notify_one();
+				return;
+			}
+			Pending.erase(job->Key);
+		}
+		delete job;
+	}
+
+	PathCompletion* PathService::new_completion(uint ticket, PathStatus status)
+	{
+		PathCompletion* c;
+		if (Spare.empty())
+			c = new PathCompletion();
+		else
+			c = Spare.back(), Spare.pop_back();
+		c->Ticket = ticket;
+		c->Result.Path.clear();
+		c->Result.Status      = status;
+		c->Result.NumOpened   = 0;
+		c->Result.NumReopened = 0;
+		c->Result.MaxDepth    = 0;
+		return c;
+	}
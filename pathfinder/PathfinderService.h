@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PATHFINDER_SERVICE_H
+#define PATHFINDER_SERVICE_H
+
+#include "PathfinderAstar.h"
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+// a finished PathService request, see PathService::Poll()
+struct PathCompletion
+{
+	uint Ticket;       // ticket returned by PathService::Request()
+	PathResult Result; // PATH_TIMEOUT if the deadline passed before the path was found
+};
+
+/**
+ * Asynchronous path requests for gameplay code. Requests are queued with a priority
+ * and a deadline, searched on background workers, and the results are collected
+ * once per frame with Poll(), so the frame thread never blocks on a search.
+ *
+ * Requests with the same start, end and post-processing share a single search,
+ * which runs until the latest deadline of its requests. Searches run in slices of
+ * SliceExpansions nodes (PathfinderAstar::Step()), so a canceled or late search
+ * gives up its worker within a slice instead of running to the end. Every request
+ * that isn't done by its own deadline completes with PATH_TIMEOUT.
+ * @note The grid must not be modified while requests are in flight
+ */
+struct PathService
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// a queued or running search, shared by all tickets of identical requests
+	struct Job
+	{
+		PathRequest Request;
+		int Start, End;              // cell indices of the request
+		__int64 Key;                 // deduplication key of start, end and post-processing
+		int  Priority;               // highest priority of all tickets
+		uint Sequence;               // FIFO order among equal priorities
+		Clock::time_point Deadline;  // earliest deadline of all tickets, orders the Queue, fixed once Running
+		std::atomic<Clock::rep> LastDeadline; // latest deadline of all tickets in clock ticks, the search gives up after it
+		bool Running;                // picked up by a worker
+		std::atomic<bool> Canceled;  // all tickets were canceled, the worker drops the job
+		PfVector<uint> Tickets;      // tickets waiting for this job
+		PfVector<Clock::time_point> Deadlines; // deadline of every ticket, same order as Tickets
+	};
+
+	const PathfinderAstar* Finder;
+	std::vector<std::thread> Threads;          // background workers
+	std::mutex Mutex;                          // guards everything below
+	std::condition_variable WakeCond;          // signaled when a job is queued
+	std::vector<Job*> Queue;                   // heap of queued jobs, the next job to run on top
+	std::unordered_map<__int64, Job*> Pending; // queued and running jobs by Key, for deduplication
+	std::unordered_map<uint, Job*> Tickets;    // job of every ticket that isn't done yet
+	std::vector<PathCompletion*> Done;         // completion queue, drained by Poll()
+	std::vector<PathCompletion*> Spare;        // recycled completions and their path buffers
+	uint NextTicket;
+	uint NextSequence;
+	bool Quit;                                 // tells all workers to exit
+
+	int SliceExpansions; // nodes expanded between the cancel and deadline checks
+	int NumRequested;    // total number of requests
+	int NumShared;       // requests that joined an identical queued or running job
+	int NumTimedOut;     // requests completed with PATH_TIMEOUT
+
+	inline PathService()
+		: Finder(0), NextTicket(0), NextSequence(0), Quit(false),
+		  SliceExpansions(1024), NumRequested(0), NumShared(0), NumTimedOut(0)
+	{
+	}
+	inline ~PathService() { Destroy(); }
+	PathService(const PathService& other)          = delete; // NOCOPY
+	PathService& operator=(const PathService& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Starts the background workers for the grid of the pathfinder
+	 * @param numWorkers Number of worker threads. If <= 0, one less than the number
+	 *                   of hardware threads is used, leaving a core for the frame thread
+	 */
+	void Create(const PathfinderAstar* finder, int numWorkers = 0);
+
+	/**
+	 * @brief Stops the workers and drops all pending requests and undelivered results
+	 */
+	void Destroy();
+
+	/**
+	 * @brief Queues a path request. Higher priorities run first, equal priorities run
+	 *        earliest deadline first and then in request order
+	 * @param maxLatency Seconds from now until the result is no longer useful,
+	 *                   <= 0 for no deadline
+	 * @return Ticket of the request, never 0
+	 */
+	uint Request(const PathRequest& req, int priority = 0, float maxLatency = 0.0f);
+
+	/**
+	 * @brief Cancels a request, for example when the unit got a new order.
+	 *        No completion will be delivered for the ticket
+	 * @return TRUE if the request was still pending or undelivered
+	 */
+	bool Cancel(uint ticket);
+
+	/**
+	 * @brief Collects finished requests, call once per frame.
+	 *        Path buffers are swapped, so the buffers of out[] are reused
+	 * @return Number of completions written to out
+	 */
+	int Poll(PathCompletion* out, int maxCount);
+
+	/** @return Number of requests that haven't been delivered by Poll() yet */
+	int NumPending();
+
+	void worker_main();
+	// Mutex must be held. Requeues the job if it timed out before the deadline of a ticket that joined late
+	void complete(Job* job, PathStatus status, const PathSearch* search);
+	PathCompletion* new_completion(uint ticket, PathStatus status);
+};
+
+
+#endif // PATHFINDER_SERVICE_H
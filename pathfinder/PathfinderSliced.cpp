@@ -0,0 +1,123 @@
+/**
+ * Time-sliced, resumable searches for spreading long searches over several frames
+ */
+#include "AstarPolicies.h"
+#include "Timer.h"
+
+
+	SearchStatus PathfinderAstar::BeginSearch(PathSearch& search, int start, int end, int agentSize) const
+	{
+		SearchContext& ctx = search.Context;
+		const int numCells = Grid.Width * Grid.Height;
+		if (ctx.NumStates != numCells)
+			ctx.create(Grid, numCells); // sliced searches are the long ones, reserve for the worst case
+		ctx.begin_search();
+		ctx.MaxDepth = 0;
+
+		search.Path.clear();
+		search.Start    = start;
+		search.End      = end;
+		search.Head     = start;
+		search.NumSteps = 0;
+		search.AgentSize = agentSize;
+
+		const ushort* planes = Grid.Planes;
+		if (start == -1 || end == -1 || planes[start] != planes[end] || planes[start] == 1)
+			return search.Status = SEARCH_FAILED; // no possible path between these two, or collision planes(1)
+		if (agentSize > 1 && (!Grid.fits(start, agentSize) || !Grid.fits(end, agentSize)))
+			return search.Status = SEARCH_FAILED; // the agent doesn't fit on the start or the end
+
+		AstarBegin(ctx, start);
+		return search.Status = SEARCH_IN_PROGRESS;
+	}
+
+	SearchStatus PathfinderAstar::Step(PathSearch& search, int maxExpansions) const
+	{
+		if (search.Status != SEARCH_IN_PROGRESS)
+			return search.Status;
+		if (maxExpansions < 1)
+			maxExpansions = 1;
+
+		++search.NumSteps;
+		SearchContext& ctx = search.Context;
+		int head = search.Explored
+			? AstarDispatch<ManhattanHeuristic, Connect8>(*this, ctx, search.Head, search.End, ExploredTrace(search.Explored), maxExpansions, search.AgentSize)
+			: AstarDispatch<ManhattanHeuristic, Connect8>(*this, ctx, search.Head, search.End, NoTrace(), maxExpansions, search.AgentSize);
+
+		if (head == -1)
+			return search.Status = SEARCH_FAILED;
+		if (head != search.End)
+		{
+			search.Head = head;
+			return SEARCH_IN_PROGRESS;
+		}
+
+		// construct the out path [end .. start]
+		const AstarState* states = ctx.States;
+		int index = head;
+		do {
+			search.Path.push_back(ToScreenCoordCentered(index));
+		} while ((index = states[index].Prev) != -1);
+		return search.Status = SEARCH_FOUND;
+	}
+
+	void PathfinderAstar::Cancel(PathSearch& search) const
+	{
+		if (search.Status == SEARCH_IN_PROGRESS)
+		{
+			search.Context.Open.clear();
+			search.Status = SEARCH_FAILED;
+		}
+	}
+
+
+
+
+	void PathSearchQueue::add(PathSearch* search)
+	{
+		Searches.push_back(search);
+	}
+
+	void PathSearchQueue::remove(PathSearch* search)
+	{
+		for (int i = 0; i < Searches.size(); ++i)
+		{
+			if (Searches[i] == search)
+			{
+				Searches.erase(i);
+				if (i < Next) --Next;
+				return;
+			}
+		}
+	}
+
+	bool PathSearchQueue::advance(const PathfinderAstar& pf, int maxExpansions)
+	{
+		bool advanced = false;
+		while (!Searches.empty() && maxExpansions > 0)
+		{
+			if (Next >= Searches.size())
+				Next = 0;
+
+			PathSearch* search = Searches[Next];
+			int slice  = SliceExpansions < maxExpansions ? SliceExpansions : maxExpansions;
+			int before = search->Context.NumExpanded;
+			if (pf.Step(*search, slice) == SEARCH_IN_PROGRESS)
+				++Next;
+			else
+				Searches.erase(Next); // done or canceled, the next search moves into this slot
+
+			int expanded = search->Context.NumExpanded - before;
+			maxExpansions -= expanded > 0 ? expanded : 1;
+			advanced = true;
+		}
+		return advanced;
+	}
+
+	bool PathSearchQueue::advance(const PathfinderAstar& pf, const SpareTime& spareTime, float bufferTime)
+	{
+		bool advanced = false;
+		while (!Searches.empty() && spareTime.TimeRemaining(bufferTime))
+			advanced |= advance(pf, SliceExpansions); // a single slice between the time checks
+		return advanced;
+	}
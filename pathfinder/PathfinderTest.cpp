@@ -4,11 +4,19 @@
 #include "PathfinderTest.h"
 #include "Input.h"
 #include "Timer.h"
+#include "GLDraw.h"
 #include <gui/GuiObject.h>
 #include <gui/freetype.h>
 #include <vector>
 using std::vector;
-#include "PathfinderAstar.h"
+#include <algorithm>
+#include "AstarPolicies.h"
+#include "PathfinderHPA.h"
+#include "PathfinderFlowField.h"
+#include "PathfinderService.h"
+#include "PathfinderCache.h"
+#include "PathfinderCooperative.h"
+#include "PathfinderDStar.h"
 
 static GuiOverlay GridOverlay;
 static GuiOverlay StartMarker;
@@ -24,6 +32,14 @@ static Vector2 WorldPos;
 static PathfinderAstar Finder;
 static bool PathChanged = false;
 
+static PathSearchQueue SearchQueue;            // sliced searches, advanced every frame and in the vsync spare time
+static PathSearch ScenePath;                   // start -> end search of the scene
+static PfVector<Vector2> SceneExplored;        // explored links of ScenePath
+static Timer SceneTimer;                       // time from BeginSearch() until ScenePath finished
+static int SceneFrames = 0;                    // frames it took to finish ScenePath
+static bool SceneSearching = false;            // the scene overlay waits for ScenePath to finish
+static const int FrameExpansions = 2000;       // minimum node budget per frame, even without spare time
+
 static Vector4 RedPath(1.0f, 0.05f, 0.05f, 0.75f);
 static Vector4 GreenExplored(0.05f, 0.8f, 0.05f, 0.75f);
 static Vector3 Indigo(0.29f, 0.0f, 0.51f);				// Indigo (blue-violet)
@@ -64,9 +80,9 @@ static void OnMouseMove(int relX, int relY, int relZ)
 		printf("px %.0f, py %.0f\n", pos.x, pos.y);
 		printf("vx %d, vy %d\n", vpos.x, vpos.y);
 
-		if (AstarNode* node = Finder.Grid.get(vpos.x, vpos.y))
+		if (Finder.Grid.index(vpos.x, vpos.y) != -1)
 		{
-			sel.set((float)node->X, (float)node->Y, 1.0f, 1.0f);
+			sel.set((float)vpos.x, (float)vpos.y, 1.0f, 1.0f);
 			sel *= Finder.CellSize;
 			Selection = &sel;
 		}
@@ -77,49 +93,523 @@ static void OnMouseMove(int relX, int relY, int relZ)
 
 
 
-void PathfinderStressTest()
+// search algorithm used by the stress test
+enum StressAlgorithm
+{
+	STRESS_ASTAR,   // PathfinderAstar::Process
+	STRESS_JPS,     // PathfinderAstar::ProcessJPS
+	STRESS_JPSPLUS, // PathfinderAstar::ProcessJPSPlus
+	STRESS_BIDIR,   // PathfinderAstar::ProcessBidirectional
+	STRESS_ALT,     // PathfinderAstar::ProcessALT
+	STRESS_THETA,   // PathfinderAstar::ProcessTheta
+	STRESS_OCTILE,  // PathfinderAstar::ProcessPolicy<OctileHeuristic>
+	STRESS_SIZE3,   // PathfinderAstar::Process for 3x3 agents
+};
+
+struct StressTestResult
+{
+	const char* algorithm;
+	const char* container;
+	double elapsed;
+	int queries;
+	int opens;
+	int reopens;
+	int maxdepth;
+	int medianExpanded; // median of closed nodes per query
+	int maxExpanded;    // worst case of closed nodes per query
+};
+
+// fills in the median and worst case of the per-query expansion counts
+static void StressExpansionStats(PfVector<int>& expanded, StressTestResult& r)
+{
+	if (expanded.empty())
+		return;
+	int* first = expanded.Data;
+	int* last  = expanded.Data + expanded.size();
+	std::nth_element(first, first + expanded.size() / 2, last);
+	r.medianExpanded = first[expanded.size() / 2];
+	r.maxExpanded    = *std::max_element(first, last);
+}
+
+#if _DEBUG
+static const int StressIterations = 5;
+#else
+static const int StressIterations = 50;
+#endif
+
+template<class OpenList> static StressTestResult PathfinderStressTest(StressAlgorithm algorithm = STRESS_ASTAR)
 {
-	const char* container = typeid(PfOpenList).name() + 7; // skip "struct "
+	static const char* names[] = { "astar", "jps", "jps+", "bidir", "alt", "theta", "octile", "size3" };
+	StressTestResult r = { names[algorithm], 
+		typeid(OpenList).name() + 7, 0.0, 0, 0, 0, 0 }; // skip "struct "
 	int width  = Finder.Grid.Width;
 	int height = Finder.Grid.Height;
 	PfVector<Vector2> path;
+	PfVector<int> expanded; // closed nodes of every query in the first iteration
+	SearchContextT<OpenList> ctx;
+	SearchContextT<OpenList> reverseCtx;
+	ctx.create(Finder.Grid, width * height);
+	if (algorithm == STRESS_BIDIR)
+		reverseCtx.create(Finder.Grid, width * height);
 	Finder.SetStart(0, 0);
-	int opens = 0;
-	int reopens = 0;
-#if _DEBUG
-	const int iterations = 5;
-#else
-	const int iterations = 50;
-#endif
 
-	double pfElapsed = Timer::Measure([&]()
+	const int agentSize = algorithm == STRESS_SIZE3 ? 3 : 1;
+	if (agentSize > 1)
 	{
+		if (!Finder.Grid.Clearance)
+			Finder.CreateClearance();
+		for (int cell = 0; cell < width * height; ++cell) // (0, 0) is on the border, start from the first cell a 3x3 agent fits on
+			if (Finder.Grid.fits(cell, agentSize)) { Finder.Start = cell; break; }
+	}
 
-		for (int i = 0; i < iterations; ++i)
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
 		for (int x = 0; x < width;  ++x)
 		for (int y = 0; y < height; ++y)
 		{
 			Finder.SetEnd(x, y);
-			if (Finder.Start && Finder.End)
+			if (Finder.Start != -1 && Finder.End != -1)
 			{
-				Finder.Process(path, NULL);
+				if (algorithm == STRESS_OCTILE)
+					Finder.ProcessPolicy<OctileHeuristic>(ctx, Finder.Start, Finder.End, path);
+				else if (algorithm == STRESS_THETA)
+					Finder.ProcessTheta(ctx, Finder.Start, Finder.End, path, NULL);
+				else if (algorithm == STRESS_ALT)
+					Finder.ProcessALT(ctx, Finder.Start, Finder.End, path, NULL);
+				else if (algorithm == STRESS_BIDIR)
+					Finder.ProcessBidirectional(ctx, reverseCtx, Finder.Start, Finder.End, path, NULL);
+				else if (algorithm == STRESS_JPSPLUS)
+					Finder.ProcessJPSPlus(ctx, Finder.Start, Finder.End, path, NULL);
+				else if (algorithm == STRESS_JPS)
+					Finder.ProcessJPS(ctx, Finder.Start, Finder.End, path, NULL);
+				else
+					Finder.Process(ctx, Finder.Start, Finder.End, path, NULL, agentSize);
 				path.clear();
-				opens   += Finder.NumOpened;
-				reopens += Finder.NumReopened;
+				++r.queries;
+				r.opens   += ctx.NumOpened;
+				r.reopens += ctx.NumReopened;
+				if (i == 0) expanded.push_back(ctx.NumExpanded);
+			}
+		}
+	});
+	r.maxdepth = ctx.MaxDepth;
+	StressExpansionStats(expanded, r);
+	return r;
+}
+
+// runs the same queries through ProcessBatch() on all worker threads
+static StressTestResult PathfinderBatchStressTest()
+{
+	static char name[32];
+	Finder.CreateWorkers();
+	sprintf(name, "batch x%d", Finder.Workers.size());
+
+	StressTestResult r = { "astar", name, 0.0, 0, 0, 0, 0 };
+	int width = Finder.Grid.Width;
+	int count = width * Finder.Grid.Height;
+	PathRequest* reqs    = new PathRequest[count];
+	PathResult*  results = new PathResult[count];
+	for (int i = 0; i < count; ++i)
+	{
+		reqs[i].Start.set(0, 0);
+		reqs[i].End.set(i % width, i / width);
+	}
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+			Finder.ProcessBatch(reqs, count, results);
+	});
+	r.queries = count * StressIterations;
+	for (int i = 0; i < count; ++i)
+	{
+		r.opens   += results[i].NumOpened * StressIterations;
+		r.reopens += results[i].NumReopened * StressIterations;
+		if (results[i].MaxDepth > r.maxdepth) r.maxdepth = results[i].MaxDepth;
+	}
+
+	delete[] reqs;
+	delete[] results;
+	return r;
+}
+
+// runs the same queries through PathService on the background workers, polled like a frame loop would
+static StressTestResult PathfinderServiceStressTest()
+{
+	static char name[32];
+	PathService service;
+	service.Create(&Finder);
+	sprintf(name, "service x%d", int(service.Threads.size()));
+
+	StressTestResult r = { "astar", name, 0.0, 0, 0, 0, 0 };
+	int width = Finder.Grid.Width;
+	int count = width * Finder.Grid.Height;
+	PathCompletion* done = new PathCompletion[count];
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+		{
+			PathRequest req;
+			req.Start.set(0, 0);
+			for (int cell = 0; cell < count; ++cell)
+			{
+				req.End.set(cell % width, cell / width);
+				service.Request(req);
+			}
+			for (int received = 0; received < count; )
+				received += service.Poll(done + received, count - received);
+		}
+	});
+	r.queries = count * StressIterations;
+	for (int i = 0; i < count; ++i)
+	{
+		r.opens   += done[i].Result.NumOpened * StressIterations;
+		r.reopens += done[i].Result.NumReopened * StressIterations;
+		if (done[i].Result.MaxDepth > r.maxdepth) r.maxdepth = done[i].Result.MaxDepth;
+	}
+
+	delete[] done;
+	return r;
+}
+
+// repeats the same queries through a PathCache, so only the first iteration searches
+static StressTestResult PathfinderCacheStressTest()
+{
+	PathCache cache;
+	cache.Create(&Finder, 64 * 1024 * 1024);
+
+	StressTestResult r = { "astar", "cache", 0.0, 0, 0, 0, 0 };
+	int width  = Finder.Grid.Width;
+	int height = Finder.Grid.Height;
+	int start  = Finder.Grid.index(0, 0);
+	PfVector<Vector2> path;
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+		for (int x = 0; x < width;  ++x)
+		for (int y = 0; y < height; ++y)
+		{
+			cache.Process(start, Finder.Grid.index(x, y), 0, path);
+			path.clear();
+			++r.queries;
+		}
+	});
+	printf("Path cache: %d paths %dKB, hit rate %.1f%%, %d evictions\n", 
+		cache.Size(), int(cache.NumBytes / 1024), cache.HitRate() * 100.0f, cache.NumEvictions);
+	return r;
+}
+
+// moves agents from the free cells of the left half to the right half with WHCA*,
+// every window search counts as a query
+static StressTestResult PathfinderCooperativeStressTest()
+{
+	static char name[32];
+	CooperativePlanner planner;
+	planner.Create(&Finder);
+
+	int width  = Finder.Grid.Width;
+	int height = Finder.Grid.Height;
+	const ushort* planes = Finder.Grid.Planes;
+	for (int y = 0; y < height; y += 2)
+	for (int x = 0; x < width / 2; x += 2)
+	{
+		int start = Finder.Grid.index(x, y);
+		int goal  = Finder.Grid.index(width - 1 - x, height - 1 - y);
+		if (planes[start] != 1 && planes[start] == planes[goal])
+			planner.AddAgent(start, goal);
+	}
+	sprintf(name, "whca x%d", int(planner.Agents.size()));
+
+	StressTestResult r = { "coop", name, 0.0, 0, 0, 0, 0 };
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int tick = 0; tick < 256 && planner.NumArrived() < int(planner.Agents.size()); ++tick)
+			planner.Tick();
+	});
+	r.queries = planner.NumSearches;
+	r.opens   = planner.NumExpanded;
+	printf("Cooperative: %d/%d agents arrived in %d steps, %d windows, %d blocked\n", 
+		planner.NumArrived(), int(planner.Agents.size()), planner.Time, planner.NumWindows, planner.NumBlocked);
+	return r;
+}
+
+// runs the same queries on the HPA* abstract graph and refines the whole path
+static StressTestResult PathfinderHpaStressTest()
+{
+	static char name[32];
+	PathfinderHPA hpa;
+	hpa.Create(&Finder);
+	sprintf(name, "%dx%d", hpa.ClusterSize, hpa.ClusterSize);
+
+	StressTestResult r = { "hpa", name, 0.0, 0, 0, 0, 0 };
+	int width  = Finder.Grid.Width;
+	int height = Finder.Grid.Height;
+	PfVector<Vector2> path;
+	PfVector<int> expanded;
+	HpaPath abstractPath;
+	int start = Finder.Grid.index(0, 0);
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+		for (int x = 0; x < width;  ++x)
+		for (int y = 0; y < height; ++y)
+		{
+			if (hpa.FindPath(start, Finder.Grid.index(x, y), abstractPath))
+				hpa.Refine(abstractPath, path, 0);
+			path.clear();
+			++r.queries;
+			r.opens   += hpa.Context.NumOpened;
+			r.reopens += hpa.Context.NumReopened;
+			if (i == 0) expanded.push_back(hpa.Context.NumExpanded);
+		}
+	});
+	r.maxdepth = hpa.Context.MaxDepth;
+	StressExpansionStats(expanded, r);
+	return r;
+}
+
+// corner to corner queries over a 2048x2048 map with 23% random obstacles,
+// which has far more entrances than the maps the open list starts out sized for
+static StressTestResult PathfinderHpaLargeMapStressTest()
+{
+	const int size = 2048;
+	vector<byte> initData(size * size);
+	unsigned seed = 12344;
+	for (byte& cell : initData)
+	{
+		seed = seed * 1103515245u + 12345u;
+		cell = (seed >> 16) % 100 < 23 ? 0 : 255;
+	}
+	initData[0] = initData[size * size - 1] = 255; // keep both corners free
+
+	PathfinderAstar world;
+	world.Create(Finder.CellSize, size, size, initData.data());
+	PathfinderHPA hpa;
+	hpa.Create(&world);
+
+	StressTestResult r = { "hpa", "2048 rand", 0.0, 0, 0, 0, 0 };
+	PfVector<Vector2> path;
+	PfVector<int> expanded;
+	HpaPath abstractPath;
+	const int start = world.Grid.index(0, 0);
+	const int end   = world.Grid.index(size - 1, size - 1);
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+		{
+			if (hpa.FindPath(start, end, abstractPath))
+				hpa.Refine(abstractPath, path, 0);
+			path.clear();
+			++r.queries;
+			r.opens   += hpa.Context.NumOpened;
+			r.reopens += hpa.Context.NumReopened;
+			expanded.push_back(hpa.Context.NumExpanded);
+		}
+	});
+	r.maxdepth = hpa.Context.MaxDepth;
+	StressExpansionStats(expanded, r);
+	return r;
+}
+
+// builds a single flow field to the same goal and samples it from every cell,
+// which answers the same queries as above for any number of units
+static StressTestResult PathfinderFlowFieldStressTest()
+{
+	FlowFieldCache cache;
+	cache.Create(&Finder, 1);
+
+	StressTestResult r = { "flow", "dial", 0.0, 0, 0, 0, 0 };
+	int width  = Finder.Grid.Width;
+	int height = Finder.Grid.Height;
+	int goal   = Finder.Grid.index(0, 0);
+	PfVector<Vector2> path; // unit steering directions
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+		{
+			cache.Clear();
+			const FlowField* field = cache.Get(goal);
+			if (!field)
+				continue;
+			r.opens += field->NumSettled;
+			for (int cell = 0, count = width * height; cell < count; ++cell)
+			{
+				if (field->reachable(cell))
+					path.push_back(field->direction(cell));
+				++r.queries;
 			}
+			path.clear();
 		}
 	});
+	return r;
+}
 
-	int tilesPerSecond = int((1.0 / pfElapsed) * opens);
-	PathfinderSTText.CreateF(MonoFont,
-		L"A* stress-test:\n"
-		L"  <%hs>\n"
-		L"  millis   %dms\n"
-		L"  tiles/s  %d\n"
-		L"  opens    %d\n"
-		L"  reopens  %d\n"
-		L"  maxdepth %d\n",
-		container, int(pfElapsed*1000), tilesPerSecond, opens, reopens, Finder.MaxDepth);
+// movement ranges of 16 straight steps from cells along the diagonal of the map
+static StressTestResult PathfinderReachableStressTest()
+{
+	StressTestResult r = { "range", "iheap", 0.0, 0, 0, 0, 0 };
+	int width  = Finder.Grid.Width;
+	int height = Finder.Grid.Height;
+	PfVector<ReachableCell> cells;
+	SearchContext ctx;
+	ctx.create(Finder.Grid, width * height);
+
+	r.elapsed = Timer::Measure([&]()
+	{
+		for (int i = 0; i < StressIterations; ++i)
+		for (int x = 0; x < width; ++x)
+		{
+			Finder.ReachableWithin(ctx, Finder.Grid.index(x, x * height / width), 16 * 8, cells);
+			cells.clear();
+			++r.queries;
+			r.opens   += ctx.NumOpened;
+			r.reopens += ctx.NumReopened;
+		}
+	});
+	r.maxdepth = ctx.MaxDepth;
+	return r;
+}
+
+// walks a unit across a copy of the map and blocks a cell on its path every few steps.
+// D* Lite repairs its search tree after every move and edit, the octile A* row replans
+// from scratch at the same steps, so the two rows compare repair against full replanning
+static void PathfinderDStarStressTest(StressTestResult& lite, StressTestResult& replan)
+{
+	int width  = Finder.Grid.Width;
+	int height = Finder.Grid.Height;
+	int count  = width * height;
+	PfVector<byte> initData;
+	for (int cell = 0; cell < count; ++cell)
+		initData.push_back(Finder.Grid.Planes[cell] == 1 ? 0 : 255);
+
+	PathfinderAstar world; // the edits must not invalidate the tables of Finder
+	world.Create(Finder.CellSize, width, height, initData.Data, Finder.Grid.Mode, Finder.Grid.Costs);
+	PathfinderDStarLite dstar;
+	dstar.Create(&world);
+	SearchContext ctx;
+	ctx.create(world.Grid, count);
+
+	int start = -1, goal = -1; // opposite corners of the same plane
+	for (int cell = 0; cell < count && start == -1; ++cell)
+		if (world.Grid.Planes[cell] != 1) start = cell;
+	for (int cell = count - 1; cell > start && goal == -1; --cell)
+		if (world.Grid.Planes[cell] == world.Grid.Planes[start]) goal = cell;
+
+	lite   = { "dstar", "lite",   0.0, 0, 0, 0, 0 };
+	replan = { "dstar", "replan", 0.0, 0, 0, 0, 0 };
+	if (start == -1 || goal == -1)
+		return;
+
+	dstar.SetStart(world.Grid.x_of(start), world.Grid.y_of(start));
+	dstar.SetEnd(world.Grid.x_of(goal), world.Grid.y_of(goal));
+	PfVector<Vector2> litePath, replanPath;
+	PfVector<int> liteExpanded, replanExpanded;
+	int liteCell = start, replanCell = start;
+	const int editInterval = 4; // steps between edits
+	const int editAhead    = 6; // edits land this many steps ahead of the unit
+
+	for (int step = 0; liteCell != goal && step < 4 * (width + height); ++step)
+	{
+		if (step && step % editInterval == 0 && litePath.size() > editAhead + 1)
+		{
+			Vector2i v = world.ToVirtualCoord(litePath[litePath.size() - 1 - editAhead]);
+			int cell = world.Grid.index(v.x, v.y);
+			if (cell != goal && cell != replanCell)
+				world.SetBlocked(v.x, v.y, true);
+		}
+
+		litePath.clear();
+		Timer t(tstart);
+		bool found = dstar.Process(litePath);
+		lite.elapsed += t.StopElapsed();
+		++lite.queries;
+		lite.opens += dstar.NumUpdated;
+		liteExpanded.push_back(dstar.NumRepaired);
+
+		if (replanCell != goal)
+		{
+			replanPath.clear();
+			t.Start();
+			world.ProcessPolicy<OctileHeuristic>(ctx, replanCell, goal, replanPath);
+			replan.elapsed += t.StopElapsed();
+			++replan.queries;
+			replan.opens   += ctx.NumOpened;
+			replan.reopens += ctx.NumReopened;
+			replanExpanded.push_back(ctx.NumExpanded);
+			if (replanPath.size() > 1) // [end .. start], step to the cell after the start
+			{
+				Vector2i v = world.ToVirtualCoord(replanPath[replanPath.size() - 2]);
+				replanCell = world.Grid.index(v.x, v.y);
+			}
+		}
+
+		if (!found || litePath.size() < 2)
+			break; // walled in by the edits
+		Vector2i v = world.ToVirtualCoord(litePath[litePath.size() - 2]);
+		liteCell = world.Grid.index(v.x, v.y);
+		dstar.SetStart(v.x, v.y);
+	}
+	replan.maxdepth = ctx.MaxDepth;
+	StressExpansionStats(liteExpanded, lite);
+	StressExpansionStats(replanExpanded, replan);
+	printf("D* Lite: %d steps, %.2fms repairing vs %.2fms replanning\n",
+		lite.queries, lite.elapsed * 1000.0, replan.elapsed * 1000.0);
+}
+
+void PathfinderStressTest()
+{
+	StressTestResult dstarLite, dstarReplan;
+	PathfinderDStarStressTest(dstarLite, dstarReplan);
+
+	// run the same queries with every open list container and algorithm, so they can be compared side by side
+	StressTestResult results[] = {
+		PathfinderStressTest<node_vect>(),
+		PathfinderStressTest<node_heap>(),
+		PathfinderStressTest<node_iheap>(),
+		PathfinderStressTest<node_buckets>(),
+		PathfinderBatchStressTest(),
+		PathfinderServiceStressTest(),
+		PathfinderCacheStressTest(),
+		PathfinderStressTest<node_iheap>(STRESS_JPS),
+		PathfinderStressTest<node_buckets>(STRESS_JPS),
+		PathfinderStressTest<node_iheap>(STRESS_JPSPLUS),
+		PathfinderStressTest<node_buckets>(STRESS_JPSPLUS),
+		PathfinderStressTest<node_iheap>(STRESS_OCTILE), // optimal one-directional baseline of bidir
+		PathfinderStressTest<node_buckets>(STRESS_OCTILE),
+		PathfinderStressTest<node_iheap>(STRESS_BIDIR),
+		PathfinderStressTest<node_buckets>(STRESS_BIDIR),
+		PathfinderStressTest<node_iheap>(STRESS_ALT),
+		PathfinderStressTest<node_buckets>(STRESS_ALT),
+		PathfinderStressTest<node_iheap>(STRESS_THETA),
+		PathfinderStressTest<node_buckets>(STRESS_THETA),
+		PathfinderStressTest<node_iheap>(STRESS_SIZE3),
+		PathfinderHpaStressTest(),
+		PathfinderHpaLargeMapStressTest(),
+		PathfinderFlowFieldStressTest(),
+		PathfinderReachableStressTest(),
+		PathfinderCooperativeStressTest(),
+		dstarLite,
+		dstarReplan,
+	};
+
+	wchar_t text[4096];
+	int len = swprintf(text, 4096, L"A* stress-test:\n  %-6hs %-12hs %7hs %9hs %9hs %7hs %8hs %8hs %7hs %7hs\n",
+		"algo", "container", "millis", "tiles/s", "opens", "opens/q", "reopens", "maxdepth", "exp/med", "exp/max");
+	for (const StressTestResult& r : results)
+	{
+		int tilesPerSecond = int((1.0 / r.elapsed) * r.opens);
+		int opensPerQuery  = r.queries ? r.opens / r.queries : 0;
+		len += swprintf(text + len, 4096 - len, L"  %-6hs %-12hs %5dms %9d %9d %7d %8d %8d %7d %7d\n",
+			r.algorithm, r.container, int(r.elapsed*1000), tilesPerSecond, 
+			r.opens, opensPerQuery, r.reopens, r.maxdepth, r.medianExpanded, r.maxExpanded);
+	}
+	PathfinderSTText.Create(MonoFont, text, len);
 }
 
 
@@ -142,6 +632,26 @@ void PathfinderTest::Create()
 	});
 	printf("Pathfinder init: %fs\n", tCreate);
 
+	// JPS+ jump table is shipped next to the map; rebuild it if it's missing or outdated
+	const char* jumpTableFile = "pathfinding.jps";
+	if (!Finder.LoadJumpTable(jumpTableFile))
+	{
+		double tJumps = Timer::Measure([&](){ Finder.CreateJumpTable(); });
+		printf("JPS+ jump table: %fs\n", tJumps);
+		if (!Finder.SaveJumpTable(jumpTableFile))
+			printf("Failed to save %s\n", jumpTableFile);
+	}
+
+	// same for the ALT landmark costs
+	const char* landmarksFile = "pathfinding.alt";
+	if (!Finder.LoadLandmarks(landmarksFile))
+	{
+		double tLandmarks = Timer::Measure([&](){ Finder.CreateLandmarks(); });
+		printf("ALT landmarks: %fs\n", tLandmarks);
+		if (!Finder.SaveLandmarks(landmarksFile))
+			printf("Failed to save %s\n", landmarksFile);
+	}
+
 	WorldSize.set(world.width * CELLSIZE, world.height * CELLSIZE);
 
 	// initialize the visual representation of the world
@@ -168,10 +678,10 @@ void PathfinderTest::Create()
 			for (int x = 0; x < world.width; ++x)
 			{
 				origin.set(x * size.x, y * size.y);
-				AstarNode& node = Finder.Grid.Nodes[y * world.width + x];
-				gridOverlay.FillRect(origin, size, planeColors[node.Plane]);
-				if (node.Plane != 1) // no grid for obstructed areas
-					gridOverlay.RectAA(origin, size, Vector4(planeColors[node.Plane].rgb * 2.0f, 0.5f)); // brighter transparent
+				int plane = Finder.Grid.Planes[y * world.width + x];
+				gridOverlay.FillRect(origin, size, planeColors[plane]);
+				if (plane != 1) // no grid for obstructed areas
+					gridOverlay.RectAA(origin, size, Vector4(planeColors[plane].rgb * 2.0f, 0.5f)); // brighter transparent
 			}
 		}
 
@@ -180,6 +690,7 @@ void PathfinderTest::Create()
 
 
 	printf("Num Planes: %d\n", Finder.Grid.NumPlanes);
+	printf("Grid memory: %dKB, search context: %dKB\n", int(Finder.Grid.bytes() / 1024), int(Finder.Context.bytes() / 1024));
 	printf("Overlay init: %fs\n", tOverlay);
 
 	// initialize start / end markers
@@ -212,9 +723,18 @@ void PathfinderTest::Destroy()
 	PathfinderDebugText.Destroy();
 	delete MonoFont;
 	delete MonoFace;
+
+	SearchQueue.remove(&ScenePath);
+	Finder.Cancel(ScenePath);
+	ScenePath.Context.destroy();
 	Finder.Destroy();
 }
 
+bool PathfinderTest::OnSpareTime(const SpareTime& spareTime)
+{
+	return SearchQueue.advance(Finder, spareTime);
+}
+
 
 void PathfinderTest::DrawScene(ShaderProgram* ts, ShaderProgram* gui, const Matrix4& projection)
 {
@@ -223,18 +743,35 @@ void PathfinderTest::DrawScene(ShaderProgram* ts, ShaderProgram* gui, const Matr
 	float X = WorldPos.x = ((gScreen.w - WorldSize.x) / 2);
 	float Y = WorldPos.y = ((gScreen.h - WorldSize.y) / 2);
 
-	if (PathChanged && Finder.Start && Finder.End)
+	if (PathChanged && Finder.Start != -1 && Finder.End != -1)
 	{
-		PfVector<Vector2> path;
-		PfVector<Vector2> explored;
-
-		double pfElapsed = Timer::Measure([&]() {
-			if (true) // debug
-				Finder.Process(path, &explored);
-			else
-				Finder.Process(path, NULL);
-		});
 		PathChanged = false;
+		if (ScenePath.Status == SEARCH_IN_PROGRESS)
+		{
+			SearchQueue.remove(&ScenePath);
+			Finder.Cancel(ScenePath);
+		}
+		SceneExplored.clear();
+		ScenePath.Explored = true ? &SceneExplored : NULL; // debug
+		SceneTimer.Start();
+		SceneFrames = 0;
+		SceneSearching = true;
+		if (Finder.BeginSearch(ScenePath, Finder.Start, Finder.End) == SEARCH_IN_PROGRESS)
+			SearchQueue.add(&ScenePath);
+	}
+
+	SearchQueue.advance(Finder, FrameExpansions);
+	if (SceneSearching)
+		++SceneFrames;
+
+	if (SceneSearching && ScenePath.Status != SEARCH_IN_PROGRESS) // finished this frame or in the spare time before it
+	{
+		SceneSearching = false;
+		double pfElapsed = SceneTimer.StopElapsed();
+
+		PfVector<Vector2>& path     = ScenePath.Path;
+		PfVector<Vector2>& explored = SceneExplored;
+		Finder.PostProcess(path, PATH_POST_STRINGPULL); // only draw the corners
 
 		PathfinderDebugOverlay.Destroy();
 		GLDraw debugOverlay;
@@ -257,14 +794,16 @@ void PathfinderTest::DrawScene(ShaderProgram* ts, ShaderProgram* gui, const Matr
 		PathfinderDebugOverlay.Create(debugOverlay);
 		//debugOverlay.Clear();
 
+		const SearchContext& ctx = ScenePath.Context;
 		PathfinderDebugText.CreateF(MonoFont, 
 			L"A* pathfinder\n"
 			L"  millis  %dms\n"
-			L"  micros  %dus\n"
+			L"  frames  %d\n"
+			L"  steps   %d\n"
 			L"  opens   %d\n"
 			L"  reopens %d\n"
 			L"  links   %d\n",
-			int(pfElapsed*1000), int(pfElapsed*1000000), Finder.NumOpened, Finder.NumReopened, numLinks);
+			int(pfElapsed*1000), SceneFrames, ScenePath.NumSteps, ctx.NumOpened, ctx.NumReopened, numLinks);
 	}
 
 	gui->Bind(); // overlay graphics
@@ -273,11 +812,11 @@ void PathfinderTest::DrawScene(ShaderProgram* ts, ShaderProgram* gui, const Matr
 		GridOverlay.Draw(projection);
 		PathfinderDebugOverlay.SetPosition(WorldPos);
 		PathfinderDebugOverlay.Draw(projection);
-		if (Finder.Start) {
+		if (Finder.Start != -1) {
 			StartMarker.SetPosition(WorldPos + Finder.ToScreenCoord(Finder.Start));
 			StartMarker.Draw(projection);
 		}
-		if (Finder.End) {
+		if (Finder.End != -1) {
 			EndMarker.SetPosition(WorldPos + Finder.ToScreenCoord(Finder.End));
 			EndMarker.Draw(projection);
 		}
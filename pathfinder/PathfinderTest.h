@@ -8,6 +8,7 @@
 #include "shader/ShaderProgram.h"
 
 extern Vector2 gScreen; // current screen size
+struct SpareTime;
 
 struct PathfinderTest
 {
@@ -17,6 +18,12 @@ struct PathfinderTest
 		ShaderProgram* texts, 
 		ShaderProgram* gui, 
 		const Matrix4& projection);
+
+	/**
+	 * @brief Advances the in-progress path searches while waiting for vsync
+	 * @return TRUE if any search was advanced
+	 */
+	static bool OnSpareTime(const SpareTime& spareTime);
 };
 
 
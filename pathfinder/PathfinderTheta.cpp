@@ -0,0 +1,174 @@
+/**
+ * Lazy Theta* any-angle search for 8-connected grids
+ * Nash, Koenig & Tovey 2010, line of sight over the bit-packed CollisionMask
+ */
+#include "PathfinderAstar.h"
+#include <math.h>
+
+
+	// length of [dx, dy] in grid gain units (straight step = 8), rounded to nearest
+	static __forceinline int distance(int dx, int dy)
+	{
+		return int(8.0f * sqrtf(float(dx * dx + dy * dy)) + 0.5f);
+	}
+
+	// euclidean heuristic, rounded down so it never exceeds distance()
+	static __forceinline int euclidean(int dx, int dy)
+	{
+		return int(8.0f * sqrtf(float(dx * dx + dy * dy)));
+	}
+
+
+	/**
+	 * Lazy Theta*: every opened node optimistically takes the parent of the node that
+	 * opened it, as if there was line of sight. The line of sight is only checked once, when
+	 * the node is expanded. If it's blocked, the node falls back to its best closed neighbor.
+	 * Prev of every node is the previous waypoint of the path, not the previous cell
+	 */
+	template<class OpenListType>
+	static bool ThetaSearch(const PathfinderAstar& pf, SearchContextT<OpenListType>& ctx,
+	                        int start, int end, PfVector<Vector2>* explored)
+	{
+		const AstarGrid& grid = pf.Grid;
+		const CollisionMask& mask = pf.LosMask;
+		const ushort* planes = grid.Planes;
+		const int width  = grid.Width;
+		const int height = grid.Height;
+		AstarState* states = ctx.States;
+		OpenListType& openList = ctx.Open;
+		const uint openID   = ctx.OpenID;
+		const uint closedID = openID | AstarState::ClosedBit;
+		const int goalX = grid.x_of(end), goalY = grid.y_of(end);
+		int numOpened   = 0;
+		int numReopened = 0;
+		int numExpanded = 0;
+		int maxDepth    = ctx.MaxDepth;
+
+		AstarState* headState = &states[start];
+		headState->GScore = 0;
+		headState->FScore = euclidean(goalX - grid.x_of(start), goalY - grid.y_of(start));
+		headState->OpenID = openID;
+		headState->Prev   = -1;
+		openList.insert(headState);
+
+		int head = -1;
+		while (!openList.empty())
+		{
+			headState = openList.pop();
+			head = int(headState - states);
+			int x = head % width, y = head / width;
+
+			if (headState->Prev != -1) // verify the assumed line of sight to the parent
+			{
+				int parent = headState->Prev;
+				if (!mask.line_of_sight(parent % width, parent / width, x, y))
+				{
+					int best = 0x7fffffff;
+					for (int i = 0; i < 8; ++i)
+					{
+						int nx = x + AstarGrid::NeighborX[i], ny = y + AstarGrid::NeighborY[i];
+						if (nx < 0 || width <= nx || ny < 0 || height <= ny)
+							continue;
+						const AstarState& n = states[ny * width + nx];
+						if (n.OpenID != closedID)
+							continue;
+						int gscore = n.GScore + ((i & 1) ? 11 : 8);
+						if (gscore < best)
+						{
+							best = gscore;
+							headState->Prev = ny * width + nx;
+						}
+					}
+					headState->GScore = best;
+				}
+			}
+			headState->OpenID = closedID;
+			++numExpanded;
+			if (head == end)
+				break;
+
+			// neighbors are connected straight to the parent of head if it has one
+			int parent = headState->Prev != -1 ? headState->Prev : head;
+			int px = parent % width, py = parent / width;
+			int parentGScore = states[parent].GScore;
+			for (int i = 0; i < 8; ++i)
+			{
+				int nx = x + AstarGrid::NeighborX[i], ny = y + AstarGrid::NeighborY[i];
+				if (nx < 0 || width <= nx || ny < 0 || height <= ny)
+					continue;
+				int index = ny * width + nx;
+				if (planes[index] == 1)
+					continue;
+
+				AstarState* s = &states[index];
+				const uint sid = s->OpenID;
+				if (sid == closedID)
+					continue;
+
+				int gscore = parentGScore + distance(nx - px, ny - py);
+				if (sid == openID)
+				{
+					if (gscore >= s->GScore)
+						continue;
+					s->FScore += gscore - s->GScore; // HScore stays the same
+					s->GScore  = gscore;
+					s->Prev    = parent;
+					++numOpened;
+					++numReopened;
+					openList.repos(s);
+				}
+				else
+				{
+					s->GScore = gscore;
+					s->FScore = gscore + euclidean(goalX - nx, goalY - ny);
+					s->Prev   = parent;
+					s->OpenID = openID;
+					++numOpened;
+					openList.insert(s);
+				}
+
+				int size = openList.size();
+				if (size > maxDepth) maxDepth = size;
+
+				if (explored)
+				{
+					explored->push_back(pf.ToScreenCoordCentered(parent));
+					explored->push_back(pf.ToScreenCoordCentered(index));
+				}
+			}
+		}
+
+		ctx.NumOpened   = numOpened;
+		ctx.NumReopened = numReopened;
+		ctx.NumExpanded = numExpanded;
+		ctx.MaxDepth    = maxDepth;
+		openList.clear();
+		return head == end;
+	}
+
+
+	template<class OpenListType>
+	bool PathfinderAstar::ProcessTheta(SearchContextT<OpenListType>& ctx, int start, int end,
+	                                   PfVector<Vector2>& outPath, PfVector<Vector2>* explored) const
+	{
+		ctx.begin_search();
+		const ushort* planes = Grid.Planes;
+		if (planes[start] != planes[end] || planes[start] == 1)
+			return false; // no possible path between these two, or collision planes(1)
+
+		if (!ThetaSearch(*this, ctx, start, end, explored))
+			return false;
+
+		// only the waypoints: [end .. start]
+		const AstarState* states = ctx.States;
+		int index = end;
+		do {
+			outPath.push_back(ToScreenCoordCentered(index));
+		} while ((index = states[index].Prev) != -1);
+		return true;
+	}
+
+	template bool PathfinderAstar::ProcessTheta(SearchContextT<node_heap>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessTheta(SearchContextT<node_vect>&,    int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessTheta(SearchContextT<node_iheap>&,   int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
+	template bool PathfinderAstar::ProcessTheta(SearchContextT<node_buckets>&, int, int, PfVector<Vector2>&, PfVector<Vector2>*) const;
@@ -0,0 +1,115 @@
+#include "PfThreadPool.h"
+
+	// pool and worker of the task running on this thread, so nested parallel_for() calls run inline
+	static thread_local const PfThreadPool* RunningPool = NULL;
+	static thread_local int RunningWorker = 0;
+
+	PfThreadPool::PfThreadPool() 
+		: CurrentTask(0), Count(0), Next(0), Pending(0), JobID(0), Quit(false)
+	{
+	}
+	PfThreadPool::~PfThreadPool()
+	{
+		destroy();
+	}
+
+	void PfThreadPool::create(int numWorkers)
+	{
+		destroy();
+		if (numWorkers <= 0)
+			numWorkers = int(std::thread::hardware_concurrency());
+		Quit = false;
+		for (int worker = 1; worker < numWorkers; ++worker)
+			Threads.emplace_back(&PfThreadPool::worker_main, this, worker, JobID);
+	}
+
+	void PfThreadPool::destroy()
+	{
+		if (Threads.empty())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Quit = true;
+		}
+		WakeCond.notify_all();
+		for (std::thread& t : Threads)
+			t.join();
+		Threads.clear();
+	}
+
+	void PfThreadPool::parallel_for(int count, const Task& task)
+	{
+		if (count <= 0)
+			return;
+
+		if (RunningPool == this) // called from one of our own tasks, which already holds CallMutex
+		{
+			for (int i = 0; i < count; ++i)
+				task(RunningWorker, i);
+			return;
+		}
+
+		std::lock_guard<std::mutex> serialize(CallMutex);
+		if (Threads.empty() || count == 1) // nothing to gain from waking up the workers
+		{
+			const PfThreadPool* outerPool = RunningPool; // a task of another pool may have called us
+			const int outerWorker = RunningWorker;
+			RunningPool   = this;
+			RunningWorker = 0;
+			for (int i = 0; i < count; ++i)
+				task(0, i);
+			RunningPool   = outerPool;
+			RunningWorker = outerWorker;
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			CurrentTask = &task;
+			Count   = count;
+			Next    = 0;
+			Pending = int(Threads.size());
+			++JobID;
+		}
+		WakeCond.notify_all();
+
+		run_tasks(0); // the calling thread is worker 0
+
+		std::unique_lock<std::mutex> lock(Mutex);
+		DoneCond.wait(lock, [this]() { return Pending == 0; });
+		CurrentTask = NULL;
+	}
+
+	void PfThreadPool::worker_main(int worker, unsigned seenJob)
+	{
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				WakeCond.wait(lock, [&]() { return Quit || JobID != seenJob; });
+				if (Quit)
+					return;
+				seenJob = JobID;
+			}
+
+			run_tasks(worker);
+
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (--Pending == 0)
+				DoneCond.notify_one();
+		}
+	}
+
+	void PfThreadPool::run_tasks(int worker)
+	{
+		const Task& task = *CurrentTask;
+		const int count  = Count;
+		const PfThreadPool* outerPool = RunningPool;
+		const int outerWorker = RunningWorker;
+		RunningPool   = this;
+		RunningWorker = worker;
+		for (int i; (i = Next++) < count; )
+			task(worker, i);
+		RunningPool   = outerPool;
+		RunningWorker = outerWorker;
+	}
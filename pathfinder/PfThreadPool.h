@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ */
+#pragma once
+#ifndef PF_THREAD_POOL_H
+#define PF_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/**
+ * A small fork-join thread pool for pathfinder batch jobs.
+ * parallel_for() hands out indices [0, count) one by one to all workers,
+ * the calling thread is always worker 0 and takes part in the work.
+ */
+struct PfThreadPool
+{
+	typedef std::function<void(int worker, int index)> Task;
+
+	std::vector<std::thread> Threads; // background workers [1, size)
+	std::mutex Mutex;                 // guards the job state below
+	std::mutex CallMutex;             // serializes concurrent parallel_for() calls
+	std::condition_variable WakeCond; // signaled when a new job is posted
+	std::condition_variable DoneCond; // signaled when the last worker finishes a job
+	const Task* CurrentTask;          // task of the current job
+	int  Count;                       // number of indices in the current job
+	std::atomic<int> Next;            // next index to hand out
+	int  Pending;                     // number of background workers still busy with the job
+	unsigned JobID;                   // incremented for every posted job
+	bool Quit;                        // tells all workers to exit
+
+	PfThreadPool();
+	~PfThreadPool();
+	PfThreadPool(const PfThreadPool& other)          = delete; // NOCOPY
+	PfThreadPool& operator=(const PfThreadPool& rhs) = delete; // NOCOPY
+
+	/**
+	 * @brief Starts the worker threads
+	 * @param numWorkers Total number of workers including the calling thread.
+	 *                   If <= 0, the number of hardware threads is used
+	 */
+	void create(int numWorkers = 0);
+
+	/**
+	 * @brief Stops and joins all worker threads
+	 */
+	void destroy();
+
+	/** @return Number of workers, including the calling thread */
+	inline int size() const { return int(Threads.size()) + 1; }
+
+	/**
+	 * @brief Runs task(worker, index) for every index in [0, count) and waits until all are done
+	 * @note  worker is in [0, size()) and can be used to index per-worker scratch data
+	 * @note  A nested call from inside a task runs inline on the calling worker, with its worker index
+	 *        even if tasks of other pools are in between. Only the thread running the outer task knows
+	 *        about it, so tasks of another pool must not call back into this one from their own workers
+	 */
+	void parallel_for(int count, const Task& task);
+
+	void worker_main(int worker, unsigned seenJob);
+	void run_tasks(int worker);
+};
+
+#endif // PF_THREAD_POOL_H
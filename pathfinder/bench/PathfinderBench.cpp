@@ -0,0 +1,515 @@
+/**
+ * Copyright (c) 2013 - Jorma Rebane
+ *
+ * Headless pathfinding benchmark. Loads a BMP map through Image, runs the queries of a
+ * MovingAI .scen file (or random queries) with every requested algorithm and open list,
+ * and writes the per-query latency percentiles, search statistics and memory use as JSON.
+ *
+ *   PathfinderBench --map maze512.bmp --scen maze512.map.scen --algo astar,jps --out results.json
+ */
+#include "pathfinder/PathfinderAstar.h"
+#include "pathfinder/AstarPolicies.h"
+#include "Image.h"
+#include "Timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using std::string;
+using std::vector;
+
+// search algorithm of a benchmark run, same set as the stress test of PathfinderTest
+enum BenchAlgorithm
+{
+	BENCH_ASTAR,   // PathfinderAstar::Process
+	BENCH_OCTILE,  // PathfinderAstar::ProcessPolicy<OctileHeuristic>
+	BENCH_ALT,     // PathfinderAstar::ProcessALT
+	BENCH_BIDIR,   // PathfinderAstar::ProcessBidirectional
+	BENCH_JPS,     // PathfinderAstar::ProcessJPS
+	BENCH_JPSPLUS, // PathfinderAstar::ProcessJPSPlus
+	BENCH_THETA,   // PathfinderAstar::ProcessTheta
+	BENCH_SIZE3,   // PathfinderAstar::Process for 3x3 agents
+	BENCH_NUM_ALGORITHMS
+};
+static const char* AlgorithmNames[BENCH_NUM_ALGORITHMS] = {
+	"astar", "octile", "alt", "bidir", "jps", "jps+", "theta", "size3"
+};
+
+enum BenchContainer
+{
+	BENCH_VECT,
+	BENCH_HEAP,
+	BENCH_IHEAP,
+	BENCH_BUCKETS,
+	BENCH_NUM_CONTAINERS
+};
+static const char* ContainerNames[BENCH_NUM_CONTAINERS] = { "node_vect", "node_heap", "node_iheap", "node_buckets" };
+
+struct BenchQuery
+{
+	int Start;     // cell index
+	int End;       // cell index
+};
+
+struct BenchOptions
+{
+	const char* Map;      // BMP map
+	const char* Scen;     // MovingAI scenario file, NULL for random queries
+	const char* Out;      // JSON output file, NULL for stdout
+	int NumRandom;        // number of random queries if there is no scenario
+	int Seed;             // seed of the random queries
+	int Iterations;       // measured passes over all queries
+	int Warmup;           // unmeasured passes before the measured ones
+	bool Compact;         // GRID_COMPACT instead of GRID_LINKED
+	bool Help;            // print the usage and exit
+	bool Algorithms[BENCH_NUM_ALGORITHMS];
+	bool Containers[BENCH_NUM_CONTAINERS];
+};
+
+struct BenchResult
+{
+	BenchAlgorithm Algorithm;
+	BenchContainer Container;
+	int Queries;           // measured queries, all iterations
+	int Found;             // queries of a single pass that found a path
+	double TotalMs;        // sum of all measured query latencies
+	double MeanUs, P50Us, P90Us, P99Us, MaxUs; // per-query latency
+	long long Opened;      // single pass totals
+	long long Reopened;
+	long long Expanded;
+	int P50Expanded, P99Expanded, MaxExpanded; // per-query closed nodes
+	int MaxDepth;          // peak open list depth of any query
+	size_t ContextBytes;   // node states of the search contexts
+};
+
+static PathfinderAstar Finder;
+
+
+
+// nearest-rank percentile of sorted values
+template<class T> static T Percentile(const vector<T>& sorted, double p)
+{
+	if (sorted.empty())
+		return T();
+	size_t rank = size_t(p * sorted.size() + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > sorted.size()) rank = sorted.size();
+	return sorted[rank - 1];
+}
+
+static bool ParseList(const char* list, const char* const* names, int count, bool* out)
+{
+	for (int i = 0; i < count; ++i)
+		out[i] = false;
+	if (strcmp(list, "all") == 0)
+	{
+		for (int i = 0; i < count; ++i)
+			out[i] = true;
+		return true;
+	}
+	string s = list;
+	for (size_t pos = 0; pos <= s.size(); )
+	{
+		size_t comma = s.find(',', pos);
+		if (comma == string::npos) comma = s.size();
+		string name = s.substr(pos, comma - pos);
+		int i = 0;
+		for (; i < count; ++i)
+			if (name == names[i] || (strncmp(names[i], "node_", 5) == 0 && name == names[i] + 5))
+				break;
+		if (i == count)
+		{
+			fprintf(stderr, "unknown name '%s'\n", name.c_str());
+			return false;
+		}
+		out[i] = true;
+		pos = comma + 1;
+	}
+	return true;
+}
+
+static void PrintUsage(FILE* f)
+{
+	fprintf(f,
+		"usage: PathfinderBench --map <file.bmp> [--scen <file.scen> | --random <N>] [options]\n"
+		"  --algo <list>       astar,octile,alt,bidir,jps,jps+,theta,size3 or all (default astar)\n"
+		"  --container <list>  vect,heap,iheap,buckets or all (default all)\n"
+		"  --iterations <N>    measured passes over all queries (default 1)\n"
+		"  --warmup <N>        unmeasured passes before the measured ones (default 1)\n"
+		"  --seed <N>          seed of the random queries (default 12344)\n"
+		"  --compact           use GRID_COMPACT instead of GRID_LINKED\n"
+		"  --out <file.json>   write the results to a file instead of stdout\n"
+		"  --help              print this message\n");
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& opt)
+{
+	memset(&opt, 0, sizeof(opt));
+	opt.Seed       = 12344;
+	opt.Iterations = 1;
+	opt.Warmup     = 1;
+	opt.Algorithms[BENCH_ASTAR] = true;
+	for (int i = 0; i < BENCH_NUM_CONTAINERS; ++i)
+		opt.Containers[i] = true;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+		if (strcmp(arg, "--compact") == 0) { opt.Compact = true; continue; }
+		if (strcmp(arg, "--help") == 0)    { opt.Help = true; return true; }
+		if (!val)
+		{
+			fprintf(stderr, "missing value for %s\n", arg);
+			return false;
+		}
+		++i;
+		if      (strcmp(arg, "--map") == 0)        opt.Map  = val;
+		else if (strcmp(arg, "--scen") == 0)       opt.Scen = val;
+		else if (strcmp(arg, "--out") == 0)        opt.Out  = val;
+		else if (strcmp(arg, "--random") == 0)     opt.NumRandom  = atoi(val);
+		else if (strcmp(arg, "--seed") == 0)       opt.Seed       = atoi(val);
+		else if (strcmp(arg, "--iterations") == 0) opt.Iterations = std::max(1, atoi(val));
+		else if (strcmp(arg, "--warmup") == 0)     opt.Warmup     = std::max(0, atoi(val));
+		else if (strcmp(arg, "--algo") == 0)
+		{
+			if (!ParseList(val, AlgorithmNames, BENCH_NUM_ALGORITHMS, opt.Algorithms))
+				return false;
+		}
+		else if (strcmp(arg, "--container") == 0)
+		{
+			if (!ParseList(val, ContainerNames, BENCH_NUM_CONTAINERS, opt.Containers))
+				return false;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", arg);
+			return false;
+		}
+	}
+	if (!opt.Map || (!opt.Scen && opt.NumRandom <= 0))
+		return false;
+	return true;
+}
+
+
+
+/**
+ * Reads a MovingAI scenario: a "version" line and then one query per line
+ *   bucket  map  mapwidth  mapheight  startx  starty  goalx  goaly  optimal
+ * Scenario y runs top-down, Image rows run bottom-up like the BMP, so y is flipped.
+ * Queries on blocked cells or outside of the map are skipped
+ */
+static bool LoadScenario(const char* filename, vector<BenchQuery>& out, int& skipped)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f)
+		return false;
+
+	const AstarGrid& grid = Finder.Grid;
+	const int width = grid.Width, height = grid.Height;
+	char line[1024], mapName[512];
+	bool mismatch = false;
+	skipped = 0;
+	while (fgets(line, sizeof line, f))
+	{
+		int bucket, mapW, mapH, sx, sy, gx, gy;
+		float optimal;
+		if (sscanf(line, "%d %511s %d %d %d %d %d %d %f", &bucket, mapName,
+		           &mapW, &mapH, &sx, &sy, &gx, &gy, &optimal) != 9)
+			continue; // version line or garbage
+
+		if ((mapW != width || mapH != height) && !mismatch)
+		{
+			fprintf(stderr, "warning: %s is for a %dx%d map\n", filename, mapW, mapH);
+			mismatch = true;
+		}
+		sy = height - 1 - sy;
+		gy = height - 1 - gy;
+		if (unsigned(sx) >= unsigned(width) || unsigned(sy) >= unsigned(height) ||
+		    unsigned(gx) >= unsigned(width) || unsigned(gy) >= unsigned(height))
+		{
+			++skipped;
+			continue;
+		}
+		BenchQuery q = { grid.index(sx, sy), grid.index(gx, gy) };
+		if (grid.Planes[q.Start] == 1 || grid.Planes[q.End] == 1)
+		{
+			++skipped;
+			continue;
+		}
+		out.push_back(q);
+	}
+	fclose(f);
+	return true;
+}
+
+// random queries between passable cells, including unreachable pairs like in a real game
+static void RandomQueries(int count, int seed, vector<BenchQuery>& out)
+{
+	const AstarGrid& grid = Finder.Grid;
+	vector<int> open;
+	for (int cell = 0, n = grid.Width * grid.Height; cell < n; ++cell)
+		if (grid.Planes[cell] != 1)
+			open.push_back(cell);
+	if (open.empty())
+		return;
+
+	unsigned int state = unsigned(seed) * 2654435761u + 1;
+	auto next = [&]() { state = state * 1664525u + 1013904223u; return state >> 8; };
+	for (int i = 0; i < count; ++i)
+	{
+		BenchQuery q = { int(open[next() % open.size()]), int(open[next() % open.size()]) };
+		out.push_back(q);
+	}
+}
+
+
+
+template<class OpenList> static bool RunQuery(BenchAlgorithm algorithm, SearchContextT<OpenList>& ctx,
+                                              SearchContextT<OpenList>& reverseCtx, const BenchQuery& q,
+                                              PfVector<Vector2>& path)
+{
+	switch (algorithm)
+	{
+		default:
+		case BENCH_ASTAR:   return Finder.Process(ctx, q.Start, q.End, path, NULL);
+		case BENCH_OCTILE:  return Finder.ProcessPolicy<OctileHeuristic>(ctx, q.Start, q.End, path);
+		case BENCH_ALT:     return Finder.ProcessALT(ctx, q.Start, q.End, path, NULL);
+		case BENCH_BIDIR:   return Finder.ProcessBidirectional(ctx, reverseCtx, q.Start, q.End, path, NULL);
+		case BENCH_JPS:     return Finder.ProcessJPS(ctx, q.Start, q.End, path, NULL);
+		case BENCH_JPSPLUS: return Finder.ProcessJPSPlus(ctx, q.Start, q.End, path, NULL);
+		case BENCH_THETA:   return Finder.ProcessTheta(ctx, q.Start, q.End, path, NULL);
+		case BENCH_SIZE3:   return Finder.Process(ctx, q.Start, q.End, path, NULL, 3);
+	}
+}
+
+template<class OpenList> static BenchResult RunBenchmark(BenchAlgorithm algorithm, BenchContainer container,
+                                                         const vector<BenchQuery>& queries, const BenchOptions& opt)
+{
+	BenchResult r;
+	memset(&r, 0, sizeof(r));
+	r.Algorithm = algorithm;
+	r.Container = container;
+
+	const int numCells = Finder.Grid.Width * Finder.Grid.Height;
+	SearchContextT<OpenList> ctx;
+	SearchContextT<OpenList> reverseCtx;
+	ctx.create(Finder.Grid, numCells);
+	if (algorithm == BENCH_BIDIR)
+		reverseCtx.create(Finder.Grid, numCells);
+
+	PfVector<Vector2> path;
+	for (int i = 0; i < opt.Warmup; ++i)
+		for (const BenchQuery& q : queries)
+		{
+			RunQuery(algorithm, ctx, reverseCtx, q, path);
+			path.clear();
+		}
+
+	vector<double> latency;
+	vector<int> expanded;
+	latency.reserve(queries.size() * opt.Iterations);
+	expanded.reserve(queries.size());
+	for (int i = 0; i < opt.Iterations; ++i)
+		for (const BenchQuery& q : queries)
+		{
+			ctx.MaxDepth = 0; // report per-query depth
+			Timer t(tstart);
+			bool found = RunQuery(algorithm, ctx, reverseCtx, q, path);
+			latency.push_back(t.StopElapsed());
+			path.clear();
+			if (i != 0)
+				continue;
+
+			// search statistics are deterministic, one pass is enough
+			r.Found    += found ? 1 : 0;
+			r.Opened   += ctx.NumOpened;
+			r.Reopened += ctx.NumReopened;
+			r.Expanded += ctx.NumExpanded;
+			expanded.push_back(ctx.NumExpanded);
+			if (ctx.MaxDepth > r.MaxDepth) r.MaxDepth = ctx.MaxDepth;
+		}
+
+	r.Queries = int(latency.size());
+	double total = 0.0;
+	for (double s : latency) total += s;
+	std::sort(latency.begin(), latency.end());
+	std::sort(expanded.begin(), expanded.end());
+	r.TotalMs     = total * 1000.0;
+	r.MeanUs      = r.Queries ? total * 1e6 / r.Queries : 0.0;
+	r.P50Us       = Percentile(latency, 0.50) * 1e6;
+	r.P90Us       = Percentile(latency, 0.90) * 1e6;
+	r.P99Us       = Percentile(latency, 0.99) * 1e6;
+	r.MaxUs       = latency.empty() ? 0.0 : latency.back() * 1e6;
+	r.P50Expanded = Percentile(expanded, 0.50);
+	r.P99Expanded = Percentile(expanded, 0.99);
+	r.MaxExpanded = expanded.empty() ? 0 : expanded.back();
+	r.ContextBytes = ctx.bytes() + reverseCtx.bytes();
+	return r;
+}
+
+static BenchResult RunBenchmark(BenchAlgorithm algorithm, BenchContainer container,
+                                const vector<BenchQuery>& queries, const BenchOptions& opt)
+{
+	switch (container)
+	{
+		default:
+		case BENCH_VECT:    return RunBenchmark<node_vect>   (algorithm, container, queries, opt);
+		case BENCH_HEAP:    return RunBenchmark<node_heap>   (algorithm, container, queries, opt);
+		case BENCH_IHEAP:   return RunBenchmark<node_iheap>  (algorithm, container, queries, opt);
+		case BENCH_BUCKETS: return RunBenchmark<node_buckets>(algorithm, container, queries, opt);
+	}
+}
+
+
+
+static long PeakRssKB()
+{
+#ifdef _WIN32
+	return 0; // not reported on Windows
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss; // KB on Linux
+#endif
+}
+
+static void WriteJsonString(FILE* f, const char* s)
+{
+	fputc('"', f);
+	for (; *s; ++s)
+	{
+		if (*s == '"' || *s == '\\') fputc('\\', f), fputc(*s, f);
+		else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+		else fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+struct BenchSetup
+{
+	double CreateMs;     // PathfinderAstar::Create()
+	double JumpTableMs;  // CreateJumpTable(), 0 if not needed
+	double LandmarksMs;  // CreateLandmarks(), 0 if not needed
+	double ClearanceMs;  // CreateClearance(), 0 if not needed
+	int NumQueries;
+	int NumSkipped;      // scenario queries outside of the map or on blocked cells
+};
+
+static void WriteJson(FILE* f, const BenchOptions& opt, const BenchSetup& setup, const vector<BenchResult>& results)
+{
+	const AstarGrid& grid = Finder.Grid;
+	fprintf(f, "{\n  \"map\": ");
+	WriteJsonString(f, opt.Map);
+	fprintf(f, ",\n  \"scenario\": ");
+	if (opt.Scen) WriteJsonString(f, opt.Scen); else fprintf(f, "null");
+	fprintf(f, ",\n  \"width\": %d,\n  \"height\": %d,\n  \"grid_mode\": \"%s\",\n",
+		grid.Width, grid.Height, opt.Compact ? "compact" : "linked");
+	fprintf(f, "  \"queries\": %d,\n  \"skipped\": %d,\n  \"iterations\": %d,\n  \"warmup\": %d,\n",
+		setup.NumQueries, setup.NumSkipped, opt.Iterations, opt.Warmup);
+	fprintf(f, "  \"setup_ms\": { \"create\": %.3f, \"jump_table\": %.3f, \"landmarks\": %.3f, \"clearance\": %.3f },\n",
+		setup.CreateMs, setup.JumpTableMs, setup.LandmarksMs, setup.ClearanceMs);
+	fprintf(f, "  \"memory_bytes\": { \"grid\": %zu, \"jump_table\": %zu, \"landmarks\": %zu, \"los_mask\": %zu },\n",
+		grid.bytes(), Finder.JumpTable.bytes(), Finder.Landmarks.bytes(), Finder.LosMask.bytes());
+	fprintf(f, "  \"peak_rss_kb\": %ld,\n  \"results\": [", PeakRssKB());
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult& r = results[i];
+		fprintf(f, "%s\n    {\n", i ? "," : "");
+		fprintf(f, "      \"algorithm\": \"%s\", \"container\": \"%s\",\n",
+			AlgorithmNames[r.Algorithm], ContainerNames[r.Container]);
+		fprintf(f, "      \"queries\": %d, \"found\": %d, \"total_ms\": %.3f,\n", r.Queries, r.Found, r.TotalMs);
+		fprintf(f, "      \"latency_us\": { \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n",
+			r.MeanUs, r.P50Us, r.P90Us, r.P99Us, r.MaxUs);
+		fprintf(f, "      \"expanded\": { \"total\": %lld, \"p50\": %d, \"p99\": %d, \"max\": %d },\n",
+			r.Expanded, r.P50Expanded, r.P99Expanded, r.MaxExpanded);
+		fprintf(f, "      \"opened\": %lld, \"reopened\": %lld, \"max_open_depth\": %d, \"context_bytes\": %zu\n    }",
+			r.Opened, r.Reopened, r.MaxDepth, r.ContextBytes);
+	}
+	fprintf(f, "\n  ]\n}\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+	BenchOptions opt;
+	if (!ParseOptions(argc, argv, opt))
+	{
+		PrintUsage(stderr);
+		return 2;
+	}
+	if (opt.Help)
+	{
+		PrintUsage(stdout);
+		return 0;
+	}
+
+	Image map;
+	if (!map.LoadFile(opt.Map) || map.Channels() != 1)
+	{
+		fprintf(stderr, "failed to load %s, expected an 8-bit BMP\n", opt.Map);
+		return 1;
+	}
+
+	BenchSetup setup;
+	memset(&setup, 0, sizeof(setup));
+	setup.CreateMs = 1000.0 * Timer::Measure([&]() {
+		Finder.Create(1.0f, map.Width(), map.Height(), map.Data(), opt.Compact ? GRID_COMPACT : GRID_LINKED);
+	});
+	if (opt.Algorithms[BENCH_JPSPLUS])
+		setup.JumpTableMs = 1000.0 * Timer::Measure([&]() { Finder.CreateJumpTable(); });
+	if (opt.Algorithms[BENCH_ALT])
+		setup.LandmarksMs = 1000.0 * Timer::Measure([&]() { Finder.CreateLandmarks(); });
+	if (opt.Algorithms[BENCH_SIZE3])
+		setup.ClearanceMs = 1000.0 * Timer::Measure([&]() { Finder.CreateClearance(); });
+
+	vector<BenchQuery> queries;
+	if (opt.Scen)
+	{
+		if (!LoadScenario(opt.Scen, queries, setup.NumSkipped))
+		{
+			fprintf(stderr, "failed to load %s\n", opt.Scen);
+			return 1;
+		}
+	}
+	else
+	{
+		RandomQueries(opt.NumRandom, opt.Seed, queries);
+	}
+	setup.NumQueries = int(queries.size());
+	fprintf(stderr, "%s: %dx%d, %d queries (%d skipped)\n", opt.Map,
+		Finder.Grid.Width, Finder.Grid.Height, setup.NumQueries, setup.NumSkipped);
+
+	vector<BenchResult> results;
+	for (int a = 0; a < BENCH_NUM_ALGORITHMS; ++a)
+	{
+		if (!opt.Algorithms[a]) continue;
+		for (int c = 0; c < BENCH_NUM_CONTAINERS; ++c)
+		{
+			if (!opt.Containers[c]) continue;
+			results.push_back(RunBenchmark(BenchAlgorithm(a), BenchContainer(c), queries, opt));
+			const BenchResult& r = results.back();
+			fprintf(stderr, "  %-6s %-12s p50 %8.1fus  p99 %8.1fus  max %8.1fus  found %d/%d\n",
+				AlgorithmNames[a], ContainerNames[c], r.P50Us, r.P99Us, r.MaxUs, r.Found, setup.NumQueries);
+		}
+	}
+
+	FILE* out = opt.Out ? fopen(opt.Out, "w") : stdout;
+	if (!out)
+	{
+		fprintf(stderr, "failed to create %s\n", opt.Out);
+		return 1;
+	}
+	WriteJson(out, opt, setup, results);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -285,6 +285,11 @@ struct read_buffer
  */
 template<class ReadBufferType> struct basic_filereader : public ReadBufferType
 {
+	// members of a dependent base are only visible through using-declarations outside of MSVC
+	using ReadBufferType::Buffer;
+	using ReadBufferType::Size;
+	using ReadBufferType::SeekPos;
+
 	/**
 	 * Creates an empty uninitialized reader. Call ::open(filename) to initialize.
 	 */
@@ -653,6 +653,11 @@ template<int SIZE> inline string_buffer& operator<<(string_buffer& os, const wch
  */
 template<class WriteBufferType> struct basic_filewriter : public WriteBufferType
 {
+	// members of a dependent base are only visible through using-declarations outside of MSVC
+	using WriteBufferType::Buffer;
+	using WriteBufferType::Size;
+	using WriteBufferType::clear;
+
 	unbuffered_file File;			// the destination file
 
 	/** @brief Creates an uninitialized filewriter object. Call open() to initialize. */
@@ -725,6 +730,10 @@ template<class WriteBufferType> struct basic_filewriter : public WriteBufferType
  */
 template<class WriteBufferType> struct basic_streamwriter : public WriteBufferType
 {
+	using WriteBufferType::Buffer;
+	using WriteBufferType::Size;
+	using WriteBufferType::clear;
+
 	file Stream;			// the destination stream
 
 	/** @brief Creates an uninitialized basic_streamwriter object. Call ::open() to initialize */
@@ -0,0 +1,434 @@
+#include "file_io.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+
+// POSIX implementation of file_io.h for the headless tools, file_io.cpp is the Win32 one.
+// Handle is a FILE*, unbuffered_file turns the stdio buffering off.
+// dirwatch is not implemented, it has no portable counterpart
+
+
+
+
+	static void* OpenFile(const char* filename, IOFlags mode, bool noBuffering)
+	{
+		const char* openMode;
+		switch (mode)
+		{
+			default:
+			case READONLY:
+			case READONLYEXECUTE: openMode = "rb";  break;
+			case READWRITE:       openMode = "r+b"; break; // if not exists, fail
+			case READWRITECREATE: openMode = "a+b"; break; // if exists, success, else create file
+			case CREATENEW:
+			case CREATETEMP:      openMode = "w+b"; break;
+		}
+
+		FILE* f = fopen(filename, openMode);
+		if (!f)
+			return 0;
+		if (mode == READWRITECREATE)
+			fseek(f, 0, SEEK_SET);
+		else if (mode == CREATETEMP)
+			remove(filename); // the data lives until the handle is closed
+		if (noBuffering)
+			setvbuf(f, NULL, _IONBF, 0);
+		return f;
+	}
+
+	static inline struct stat FileStat(void* handle)
+	{
+		struct stat st = {};
+		fstat(fileno((FILE*)handle), &st);
+		return st;
+	}
+
+
+
+
+	unbuffered_file::unbuffered_file(const char* filename, IOFlags mode) 
+		: Handle(OpenFile(filename, mode, true)), Mode(mode)
+	{
+	}
+	unbuffered_file::unbuffered_file(const std::string& filename, IOFlags mode)
+		: Handle(OpenFile(filename.c_str(), mode, true)), Mode(mode)
+	{
+	}
+	unbuffered_file::unbuffered_file(unbuffered_file&& f)
+		: Handle(f.Handle), Mode(f.Mode)
+	{
+		f.Handle = 0;
+	}
+	unbuffered_file::~unbuffered_file()
+	{
+		if (Handle)
+			fclose((FILE*)Handle);
+	}
+	unbuffered_file& unbuffered_file::operator=(unbuffered_file&& f)
+	{
+		if (Handle)
+			fclose((FILE*)Handle);
+		Handle = f.Handle;
+		Mode   = f.Mode;
+		f.Handle = 0;
+		return *this;
+	}
+	bool unbuffered_file::open(const char* filename, IOFlags mode)
+	{
+		if (Handle)
+			fclose((FILE*)Handle);
+		Mode = mode;
+		return (Handle = OpenFile(filename, mode, true)) != NULL;
+	}
+	void unbuffered_file::close()
+	{
+		if (Handle)
+		{
+			fclose((FILE*)Handle);
+			Handle = NULL;
+		}
+	}
+	bool unbuffered_file::good() const
+	{
+		return Handle != NULL;
+	}
+	bool unbuffered_file::bad() const
+	{
+		return Handle == NULL;
+	}
+	int unbuffered_file::size() const
+	{
+		return (int)FileStat(Handle).st_size;
+	}
+	unsigned __int64 unbuffered_file::sizel() const
+	{
+		return (unsigned __int64)FileStat(Handle).st_size;
+	}
+	int unbuffered_file::size_aligned() const
+	{
+		int size = (int)FileStat(Handle).st_size;
+		if (int rem = size % ALIGNMENT)
+			return (size - rem) + ALIGNMENT;
+		return size; // already aligned
+	}
+	int unbuffered_file::read(void* buffer, int bytesToRead)
+	{
+		if (bytesToRead % ALIGNMENT)
+			throw "unbuffered_file::read() 'bytesToRead' must always be aligned to 4KB!";
+		return (int)fread(buffer, 1, bytesToRead, (FILE*)Handle);
+	}
+	load_buffer unbuffered_file::readAll()
+	{
+		int alignedSize = size_aligned();
+		if (!alignedSize)
+			return load_buffer(0, 0);
+
+		char* buffer = (char*)malloc(alignedSize);
+		int bytesRead = (int)fread(buffer, 1, alignedSize, (FILE*)Handle);
+		return load_buffer(buffer, bytesRead);
+	}
+	load_buffer unbuffered_file::readAll(const char* filename)
+	{
+		return unbuffered_file(filename, READONLY).readAll();
+	}
+	load_buffer unbuffered_file::readAll(const token& filename)
+	{
+		char fileName[512];
+		int len = filename.length();
+		memcpy(fileName, filename.c_str(), len);
+		fileName[len] = '\0';
+		return readAll(fileName);
+	}
+	int unbuffered_file::write(const void* buffer, int bytesToWrite)
+	{
+		return (int)fwrite(buffer, 1, bytesToWrite, (FILE*)Handle);
+	}
+	int unbuffered_file::writenew(const char* filename, const void* buffer, int bytesToWrite)
+	{
+		return unbuffered_file(filename, IOFlags::CREATENEW).write(buffer, bytesToWrite);
+	}
+	int unbuffered_file::seek(int filepos, int seekmode)
+	{
+		fseek((FILE*)Handle, filepos, seekmode);
+		return (int)ftell((FILE*)Handle);
+	}
+	int unbuffered_file::tell() const
+	{
+		return (int)ftell((FILE*)Handle);
+	}
+	unsigned __int64 unbuffered_file::time_created() const
+	{
+		return FileStat(Handle).st_ctime; // status change, POSIX doesn't keep the creation time
+	}
+	unsigned __int64 unbuffered_file::time_accessed() const
+	{
+		return FileStat(Handle).st_atime;
+	}
+	unsigned __int64 unbuffered_file::time_modified() const
+	{
+		return FileStat(Handle).st_mtime;
+	}
+
+
+
+
+	file::file(const char* filename, IOFlags mode) 
+		: Handle(OpenFile(filename, mode, false)), Mode(mode)
+	{
+	}
+	file::file(const std::string& filename, IOFlags mode)
+		: Handle(OpenFile(filename.c_str(), mode, false)), Mode(mode)
+	{
+	}
+	file::file(file&& f)
+		: Handle(f.Handle), Mode(f.Mode)
+	{
+		f.Handle = 0;
+	}
+	file::~file()
+	{
+		if (Handle)
+			fclose((FILE*)Handle);
+	}
+	file& file::operator=(file&& f)
+	{
+		if (Handle)
+			fclose((FILE*)Handle);
+		Handle = f.Handle;
+		Mode   = f.Mode;
+		f.Handle = 0;
+		return *this;
+	}
+	bool file::open(const char* filename, IOFlags mode)
+	{
+		if (Handle)
+			fclose((FILE*)Handle);
+		Mode = mode;
+		return (Handle = OpenFile(filename, mode, false)) != NULL;
+	}
+	void file::close()
+	{
+		if (Handle)
+		{
+			fclose((FILE*)Handle);
+			Handle = NULL;
+		}
+	}
+	bool file::good() const
+	{
+		return Handle != NULL;
+	}
+	bool file::bad() const
+	{
+		return Handle == NULL;
+	}
+	int file::size() const
+	{
+		return (int)FileStat(Handle).st_size;
+	}
+	unsigned __int64 file::sizel() const
+	{
+		return (unsigned __int64)FileStat(Handle).st_size;
+	}
+	int file::read(void* buffer, int bytesToRead)
+	{
+		return (int)fread(buffer, 1, bytesToRead, (FILE*)Handle);
+	}
+	load_buffer file::readAll()
+	{
+		int fileSize = size();
+		if (!fileSize)
+			return load_buffer(0, 0);
+
+		char* buffer = (char*)malloc(fileSize);
+		int bytesRead = (int)fread(buffer, 1, fileSize, (FILE*)Handle);
+		return load_buffer(buffer, bytesRead);
+	}
+	int file::write(const void* buffer, int bytesToWrite)
+	{
+		return (int)fwrite(buffer, 1, bytesToWrite, (FILE*)Handle);
+	}
+	int file::writenew(const char* filename, const void* buffer, int bytesToWrite)
+	{
+		return unbuffered_file(filename, IOFlags::CREATENEW).write(buffer, bytesToWrite);
+	}
+	int file::seek(int filepos, int seekmode)
+	{
+		fseek((FILE*)Handle, filepos, seekmode);
+		return (int)ftell((FILE*)Handle);
+	}
+	int file::tell() const
+	{
+		return (int)ftell((FILE*)Handle);
+	}
+	unsigned __int64 file::time_created() const
+	{
+		return FileStat(Handle).st_ctime;
+	}
+	unsigned __int64 file::time_accessed() const
+	{
+		return FileStat(Handle).st_atime;
+	}
+	unsigned __int64 file::time_modified() const
+	{
+		return FileStat(Handle).st_mtime;
+	}
+
+
+
+
+	static inline bool PathStat(const char* path, struct stat& st)
+	{
+		return stat(path, &st) == 0;
+	}
+	static inline std::string TokenPath(const token& tok)
+	{
+		return std::string(tok.str, tok.end);
+	}
+
+	bool file_exists(const char* file)
+	{
+		struct stat st;
+		return PathStat(file, st) && !S_ISDIR(st.st_mode);
+	}
+	bool file_exists(const std::string& file)
+	{
+		return file_exists(file.c_str());
+	}
+	bool file_exists(const token& tokStr)
+	{
+		return file_exists(TokenPath(tokStr).c_str());
+	}
+
+
+	bool folder_exists(const char* folder)
+	{
+		struct stat st;
+		return PathStat(folder, st) && S_ISDIR(st.st_mode);
+	}
+	bool folder_exists(const std::string& folder)
+	{
+		return folder_exists(folder.c_str());
+	}
+	bool folder_exists(const token& folder)
+	{
+		return folder_exists(TokenPath(folder).c_str());
+	}
+
+	size_t file_size(const char* file)
+	{
+		struct stat st;
+		if (!PathStat(file, st))
+			return -1;
+		return (size_t)st.st_size;
+	}
+	size_t file_size(const std::string& file)
+	{
+		return file_size(file.c_str());
+	}
+
+	time_t file_modified(const char* file)
+	{
+		struct stat st;
+		return PathStat(file, st) ? st.st_mtime : 0;
+	}
+	time_t file_modified(const std::string& file)
+	{
+		return file_modified(file.c_str());
+	}
+
+
+	static int ListDir(std::vector<std::string>& out, const char* directory, const char* matchPattern, bool dirs)
+	{
+		out.clear();
+		if (strcmp(matchPattern, "*.*") == 0)
+			matchPattern = "*"; // Win32 "*.*" also matches names without an extension
+
+		DIR* dir = opendir(directory);
+		if (!dir)
+			return 0;
+
+		std::string path = directory;
+		path += '/';
+		size_t pathLen = path.size();
+		while (dirent* e = readdir(dir))
+		{
+			if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+				continue;
+			if (fnmatch(matchPattern, e->d_name, 0) != 0)
+				continue;
+			path.resize(pathLen);
+			path += e->d_name;
+			if (folder_exists(path.c_str()) == dirs)
+				out.emplace_back(e->d_name);
+		}
+
+		closedir(dir);
+		return (int)out.size();
+	}
+
+	int directory::list_dirs(std::vector<std::string>& out, const char* directory, const char* matchPattern)
+	{
+		return ListDir(out, directory, matchPattern, true);
+	}
+
+	int directory::list_files(std::vector<std::string>& out, const char* directory, const char* matchPattern)
+	{
+		return ListDir(out, directory, matchPattern, false);
+	}
+
+
+	std::string directory::get_working_dir()
+	{
+		char path[PATH_MAX];
+		return getcwd(path, sizeof path) ? std::string(path) : std::string();
+	}
+
+	void directory::set_working_dir(const std::string& new_wd)
+	{
+		if (chdir(new_wd.c_str()) != 0)
+			return; // keeps the old working dir, like SetCurrentDirectoryA
+	}
+
+	std::string directory::fullpath(const std::string& relativePath)
+	{
+		return fullpath(relativePath.c_str());
+	}
+
+	std::string directory::fullpath(const char* relativePath)
+	{
+		char path[PATH_MAX];
+		if (realpath(relativePath, path))
+			return path;
+		if (relativePath[0] == '/')
+			return relativePath;
+		return get_working_dir() + '/' + relativePath; // realpath fails on files that don't exist yet
+	}
+
+	std::string directory::filename(const std::string& someFilePath)
+	{
+		return filename(someFilePath.c_str());
+	}
+
+	std::string directory::filename(const char* someFilePath)
+	{
+		std::string path = fullpath(someFilePath);
+		return path.substr(path.rfind('/') + 1);
+	}
+
+	std::string directory::foldername(const std::string& someFolderPath)
+	{
+		return foldername(someFolderPath.c_str());
+	}
+
+	std::string directory::foldername(const char* someFolderPath)
+	{
+		std::string path = fullpath(someFolderPath);
+		return path.substr(0, path.rfind('/') + 1);
+	}
@@ -5,11 +5,26 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <string.h>
 
 //// @note Some functions get inlined too aggressively, leading to some serious code bloat
 ////       Need to hint the compiler to take it easy ^_^'
 #define NOINLINE __declspec(noinline) 
 
+#ifndef _MSC_VER
+#include <ctype.h>
+// case insensitive memcmp of the MSVC CRT
+inline int _memicmp(const void* a, const void* b, size_t count)
+{
+	const unsigned char* s1 = (const unsigned char*)a;
+	const unsigned char* s2 = (const unsigned char*)b;
+	for (size_t i = 0; i < count; ++i)
+		if (int diff = tolower(s1[i]) - tolower(s2[i]))
+			return diff;
+	return 0;
+}
+#endif
+
 /**
 * This is a simplified string tokenizer class.
 *